@@ -10,7 +10,7 @@ TARGET = sharp
 TEMPLATE = lib
 CONFIG += c++11
 #LIBS += -ljsoncpp
-LIBS += -lpaho-mqttpp3 -lpaho-mqtt3as -lyaml-cpp
+LIBS += -lpaho-mqttpp3 -lpaho-mqtt3as -lyaml-cpp -lz
 
 #Setting Command Publishing Version
 DEFINES += USING_COMMANDPUB2
@@ -49,6 +49,30 @@ SOURCES += plugin_template.cpp \
     ../../common/mission/mission_completed_data.cpp \
     command_processor/commandprocessor.cpp \
     Tools/console.cpp \
+    Tools/logwriter.cpp \
+    Tools/logqueue.cpp \
+    Tools/logmodel.cpp \
+    Tools/logformat.cpp \
+    Tools/logcompressor.cpp \
+    Tools/flightrecorder.cpp \
+    Tools/logsink.cpp \
+    Tools/mqttlogsink.cpp \
+    Tools/mqttconnection.cpp \
+    Tools/outboundbuffer.cpp \
+    Tools/statepublisher.cpp \
+    Tools/payloadcache.cpp \
+    Tools/heartbeat.cpp \
+    Tools/commandqueue.cpp \
+    Tools/commanddedup.cpp \
+    Tools/latencywindow.cpp \
+    Tools/deliverytracker.cpp \
+    Tools/topicrouter.cpp \
+    Tools/mqttsession.cpp \
+    Tools/outboundjournal.cpp \
+    Tools/payloadwriter.cpp \
+    Tools/ratelimiter.cpp \
+    Tools/logindex.cpp \
+    Tools/crashhandler.cpp \
     Tools/robotCommunication.cpp
 
 HEADERS += plugin_template.h \
@@ -62,6 +86,34 @@ HEADERS += plugin_template.h \
     ../../common/fsm_defs.h \
     command_processor/commandprocessor.h \
     Tools/console.h \
+    Tools/logwriter.h \
+    Tools/logqueue.h \
+    Tools/logmodel.h \
+    Tools/logformat.h \
+    Tools/loglevel.h \
+    Tools/logcompressor.h \
+    Tools/flightrecord.h \
+    Tools/flightrecorder.h \
+    Tools/logsink.h \
+    Tools/mqttlogsink.h \
+    Tools/mqttconnection.h \
+    Tools/outboundbuffer.h \
+    Tools/statepublisher.h \
+    Tools/payloadcache.h \
+    Tools/heartbeat.h \
+    Tools/commandqueue.h \
+    Tools/commanddedup.h \
+    Tools/requestcontext.h \
+    Tools/latencywindow.h \
+    Tools/deliverytracker.h \
+    Tools/topicrouter.h \
+    Tools/mqttsession.h \
+    Tools/outboundjournal.h \
+    Tools/payloadwriter.h \
+    Tools/ratelimiter.h \
+    Tools/logindex.h \
+    Tools/logcontext.h \
+    Tools/crashhandler.h \
     Tools/robotCommunication.h
 
 
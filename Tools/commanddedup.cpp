@@ -0,0 +1,145 @@
+#include "commanddedup.h"
+#include <cstdio>
+#include <iterator>
+
+namespace
+{
+    const char *const ID_FIELDS[] = {"command_id", "id"};
+
+    // FNV-1a, good enough to tell commands apart within a small cache
+    uint64_t hashContent(const std::string &content)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : content)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+CommandDedup::CommandDedup(size_t capacity, int window_ms)
+{
+    capacity_ = (capacity > 0)? capacity : 1;
+    window_ = std::chrono::milliseconds(window_ms);
+}
+
+void CommandDedup::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    capacity_ = (capacity > 0)? capacity : 1;
+    evict();
+}
+
+void CommandDedup::setWindow(int window_ms)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    window_ = std::chrono::milliseconds(window_ms);
+}
+
+void CommandDedup::addIdOnly(const std::string &name)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    id_only_.insert(name);
+}
+
+bool CommandDedup::check(const std::string &name, const Json::Value &message, std::string &key)
+{
+    bool has_id = false;
+    key = makeKey(message, has_id);
+    Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (!has_id && id_only_.count(name) > 0)
+    {
+        key.clear();
+        return false;
+    }
+    stats_.checked++;
+
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        Entry &entry = it->second;
+        if (entry.has_id || now - entry.accepted <= window_)
+        {
+            stats_.hits++;
+            if (entry.has_id)   stats_.id_hits++;
+            else                stats_.hash_hits++;
+            return true;
+        }
+        // Same content outside the window is a new command
+        order_.erase(entry.order);
+        entries_.erase(it);
+    }
+
+    order_.push_back(key);
+    Entry entry;
+    entry.accepted = now;
+    entry.has_id = has_id;
+    entry.order = std::prev(order_.end());
+    entries_.emplace(key, entry);
+    evict();
+    return false;
+}
+
+void CommandDedup::forget(const std::string &key)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        order_.erase(it->second.order);
+        entries_.erase(it);
+    }
+}
+
+void CommandDedup::finish(const std::string &key)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() && !it->second.has_id)
+    {
+        order_.erase(it->second.order);
+        entries_.erase(it);
+    }
+}
+
+CommandDedup::Stats CommandDedup::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    return stats;
+}
+
+void CommandDedup::evict()
+{
+    while (entries_.size() > capacity_)
+    {
+        entries_.erase(order_.front());
+        order_.pop_front();
+        stats_.evicted++;
+    }
+}
+
+std::string CommandDedup::makeKey(const Json::Value &message, bool &has_id)
+{
+    for (const char *field : ID_FIELDS)
+    {
+        const Json::Value &id = message[field];
+        if (id.isString() || id.isIntegral())
+        {
+            has_id = true;
+            return "id:" + id.asString();
+        }
+    }
+
+    // Object members are kept sorted, so equal commands serialize identically
+    Json::FastWriter writer;
+    char hash[24];
+    snprintf(hash, sizeof(hash), "hash:%016llx", static_cast<unsigned long long>(hashContent(writer.write(message))));
+    has_id = false;
+    return hash;
+}
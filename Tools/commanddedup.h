@@ -0,0 +1,91 @@
+#ifndef COMMANDDEDUP_H
+#define COMMANDDEDUP_H
+
+#include <jsoncpp/json/json.h>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief The CommandDedup class
+ * Bounded cache of recently accepted commands, catches QoS 1 redeliveries. Commands carrying a
+ * "command_id" (or "id") are keyed on it and stay known until evicted by newer ones. Commands
+ * without an id are keyed on a hash of their content and only count as duplicates within a short
+ * window, the time a redelivery takes, and until they are finished: an operator repeating e.g.
+ * "dock" deliberately gets it executed again. Oldest entries are evicted once the cache is full.
+ * Thread safe.
+ * Commands registered with addIdOnly (abort, disable) are never matched on content: repeating
+ * them must always take effect.
+ */
+class CommandDedup
+{
+    public:
+        struct Stats
+        {
+            size_t entries = 0;
+            uint64_t checked = 0;
+            uint64_t hits = 0;
+            uint64_t id_hits = 0;
+            uint64_t hash_hits = 0;
+            uint64_t evicted = 0;
+        };
+
+        /**
+         * @brief CommandDedup
+         * @param capacity      Maximum number of commands remembered
+         * @param window_ms     Duplicate window for commands without an id
+         */
+        CommandDedup(size_t capacity = 64, int window_ms = 5000);
+
+        void setCapacity(size_t capacity);
+        void setWindow(int window_ms);
+        void addIdOnly(const std::string &name);
+
+        /**
+         * @brief check     Record command, or report it as a duplicate
+         * @param key       Id or content hash the command was matched on, empty if not checked
+         * @return true if the command was already accepted
+         */
+        bool check(const std::string &name, const Json::Value &message, std::string &key);
+
+        /**
+         * @brief forget    Drop a command that was rejected after all, so it can be sent again
+         */
+        void forget(const std::string &key);
+
+        /**
+         * @brief finish    The command completed or failed. Content matches end here, an id
+         *                  stays known: it names that one command, never a deliberate repeat.
+         */
+        void finish(const std::string &key);
+
+        Stats stats(void);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Entry
+        {
+            Clock::time_point accepted;
+            bool has_id;
+            std::list<std::string>::iterator order;
+        };
+
+        std::mutex mtx_;
+        size_t capacity_;
+        std::chrono::milliseconds window_;
+        std::set<std::string> id_only_;
+
+        std::unordered_map<std::string, Entry> entries_;
+        std::list<std::string> order_;          // Oldest first
+        Stats stats_;
+
+        void evict(void);
+        static std::string makeKey(const Json::Value &message, bool &has_id);
+};
+
+#endif // COMMANDDEDUP_H
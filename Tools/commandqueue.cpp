@@ -0,0 +1,140 @@
+#include "commandqueue.h"
+#include <algorithm>
+
+CommandQueue::CommandQueue(size_t capacity)
+{
+    capacity_ = capacity;
+}
+
+void CommandQueue::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    capacity_ = capacity;
+}
+
+void CommandQueue::addPreemptCommand(const std::string &name)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    preempt_names_.insert(name);
+}
+
+bool CommandQueue::parse(const std::string &payload, InboundCommand &command)
+{
+    command.received = std::chrono::steady_clock::now();
+
+    Json::Reader reader;
+    if (!reader.parse(payload, command.message) || !command.message.isObject() || !command.message["command"].isString())
+    {
+        return false;
+    }
+    command.name = command.message["command"].asString();
+    return true;
+}
+
+bool CommandQueue::isPreempt(const std::string &payload)
+{
+    bool candidate = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        for (const std::string &name : preempt_names_)
+        {
+            if (payload.find("\"" + name + "\"") != std::string::npos)
+            {
+                candidate = true;
+                break;
+            }
+        }
+    }
+    InboundCommand command;
+    if (!candidate || !parse(payload, command))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lck(mtx_);
+    return preempt_names_.count(command.name) > 0;
+}
+
+CommandQueue::Result CommandQueue::push(InboundCommand &command, std::vector<InboundCommand> &discarded)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    command.preempt = preempt_names_.count(command.name) > 0;
+    if (command.preempt)
+    {
+        // Whatever was waiting is stale once the robot is aborted or disabled
+        discarded.insert(discarded.end(), normal_lane_.begin(), normal_lane_.end());
+        stats_.discarded += normal_lane_.size();
+        normal_lane_.clear();
+        // One of each waits at most, a repeat replaces it: a flood of aborts cannot grow the lane
+        auto same = std::find_if(preempt_lane_.begin(), preempt_lane_.end(),
+                                 [&](const InboundCommand &waiting) { return waiting.name == command.name; });
+        if (same != preempt_lane_.end())
+        {
+            discarded.push_back(*same);
+            stats_.discarded++;
+            preempt_lane_.erase(same);
+        }
+        preempt_lane_.push_back(command);
+    }
+    else if (normal_lane_.size() >= capacity_)
+    {
+        stats_.rejected++;
+        return Result::Full;
+    }
+    else
+    {
+        normal_lane_.push_back(command);
+    }
+
+    stats_.queued++;
+    stats_.max_depth = std::max(stats_.max_depth, preempt_lane_.size() + normal_lane_.size());
+    return command.preempt? Result::Preempt : Result::Queued;
+}
+
+bool CommandQueue::pop(InboundCommand &command, std::vector<InboundCommand> &expired)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    while (true)
+    {
+        std::deque<InboundCommand> &lane = preempt_lane_.empty()? normal_lane_ : preempt_lane_;
+        if (lane.empty())
+        {
+            return false;
+        }
+        command = lane.front();
+        lane.pop_front();
+        if (!command.request.expired())
+        {
+            break;
+        }
+        expired.push_back(command);
+        stats_.expired++;
+    }
+
+    double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - command.received).count();
+    stats_.dispatched++;
+    stats_.last_latency_ms = latency_ms;
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency_ms);
+    total_latency_ms_ += latency_ms;
+    return true;
+}
+
+bool CommandQueue::hasPreempt()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return !preempt_lane_.empty();
+}
+
+size_t CommandQueue::depth()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return preempt_lane_.size() + normal_lane_.size();
+}
+
+CommandQueue::Stats CommandQueue::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = stats_;
+    stats.depth = preempt_lane_.size() + normal_lane_.size();
+    stats.avg_latency_ms = (stats_.dispatched > 0)? total_latency_ms_ / stats_.dispatched : 0;
+    return stats;
+}
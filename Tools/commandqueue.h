@@ -0,0 +1,106 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <jsoncpp/json/json.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "requestcontext.h"
+
+/**
+ * @brief The InboundCommand struct
+ * Command received over MQTT, parsed once on arrival
+ */
+struct InboundCommand
+{
+    std::string name;               // "command" field
+    Json::Value message;
+    std::chrono::steady_clock::time_point received;
+    bool preempt = false;
+    std::string dedup_key;          // See CommandDedup, empty if not checked
+    RequestContext request;
+};
+
+/**
+ * @brief The CommandQueue class
+ * Bounded inbound command queue with two lanes. Preempt commands (disable, abort) are never
+ * rejected, jump ahead of everything and discard the normal commands still waiting, which the
+ * caller must answer. At most one of each preempt command waits, a repeat discards the waiting
+ * one. Normal commands wait in arrival order and are rejected once the lane is full. Tracks
+ * depth and time spent in the queue. Thread safe.
+ */
+class CommandQueue
+{
+    public:
+        enum class Result {
+            Queued,
+            Preempt,        // Queued in the preempt lane, the running command should be aborted
+            Full            // Normal lane full, command rejected
+        };
+
+        struct Stats
+        {
+            size_t depth = 0;
+            size_t max_depth = 0;
+            uint64_t queued = 0;
+            uint64_t rejected = 0;
+            uint64_t discarded = 0;         // Commands dropped by a preempt command
+            uint64_t expired = 0;           // MQTT v5 message expiry passed while queued
+            uint64_t dispatched = 0;
+            double last_latency_ms = 0;
+            double avg_latency_ms = 0;
+            double max_latency_ms = 0;
+        };
+
+        CommandQueue(size_t capacity = 4);
+
+        void setCapacity(size_t capacity);
+        void addPreemptCommand(const std::string &name);
+
+        /**
+         * @brief parse     Parse payload into command, stamps the arrival time
+         * @return false if payload is not a JSON object with a "command" field
+         */
+        static bool parse(const std::string &payload, InboundCommand &command);
+
+        /**
+         * @brief push      Queue a parsed command
+         * @param discarded Commands dropped by a preempt command: the normal ones waiting and
+         *                  an earlier instance of the same preempt command
+         */
+        Result push(InboundCommand &command, std::vector<InboundCommand> &discarded);
+
+        /**
+         * @brief pop       Next command, preempt lane first
+         * @param expired   Commands skipped because their message expiry passed, to be answered
+         * @return false if both lanes are empty
+         */
+        bool pop(InboundCommand &command, std::vector<InboundCommand> &expired);
+
+        /**
+         * @brief isPreempt     Whether payload is a preempt command, for the inbound rate limiter.
+         *                      Only payloads naming a preempt command are parsed.
+         */
+        bool isPreempt(const std::string &payload);
+
+        bool hasPreempt(void);
+        size_t depth(void);
+        Stats stats(void);
+
+    private:
+        std::mutex mtx_;
+        size_t capacity_;
+        std::set<std::string> preempt_names_;
+        std::deque<InboundCommand> preempt_lane_;
+        std::deque<InboundCommand> normal_lane_;
+
+        Stats stats_;
+        double total_latency_ms_ = 0;
+};
+
+#endif // COMMANDQUEUE_H
@@ -1,56 +1,309 @@
 #include "console.h"
+#include <algorithm>
 
-Console::Console(QTextEdit *text_edit)
+Console::Console(QListView *list_view)
 {
-    text_edit_ = text_edit;
-    text_edit_->setTextColor(QColor(0, 255, 0));
-    text_edit_->setReadOnly(true);
+    list_view_ = list_view;
+    init();
+}
 
-    QObject::connect(this, &Console::printer_msg, this, &Console::print_msg);
+Console::Console(QListView *list_view, bool std_cout)
+{
+    list_view_ = list_view;
+    cout = std_cout;
+    init();
 }
 
-Console::Console(QTextEdit *text_edit, bool std_cout)
+Console::~Console()
 {
-    text_edit_ = text_edit;
-    text_edit_->setTextColor(QColor(0, 255, 0));
-    text_edit_->setReadOnly(true);
+    CrashHandler::uninstall();
+    running_ = false;
+    dispatcher_thread_->join();
+    delete dispatcher_thread_;
 
-    cout = std_cout;
+    delete view_sink_;
+    delete stdout_sink_;
+    delete file_sink_;
+    delete log_index_;
+    // Flushes remaining log lines
+    delete log_writer_;
+}
+
+void Console::init()
+{
+    log_model_ = new LogModel(DEFAULT_MAX_LINES, this);
+    filter_model_ = new LogModel(DEFAULT_MAX_LINES, this);
+    list_view_->setModel(log_model_);
+    list_view_->setUniformItemSizes(true);
+    list_view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    list_view_->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
-    QObject::connect(this, &Console::printer_msg, this, &Console::print_msg);
+    view_sink_ = new ViewSink(LogLevel::Info, DEFAULT_MAX_LINES);
+    stdout_sink_ = new StdoutSink(cout? LogLevel::Info : LogLevel::Off);
+    log_index_ = new LogIndex(LogLevel::Info, LOG_INDEX_RETENTION);
+    sinks_.push_back(view_sink_);
+    sinks_.push_back(stdout_sink_);
+    sinks_.push_back(log_index_);
+    if (logToFile)
+    {
+        log_writer_ = new LogWriter(logFileName);
+        file_sink_ = new FileSink(log_writer_, LogLevel::Info);
+        sinks_.push_back(file_sink_);
+    }
+    updateMinLevel();
+
+    // Whatever is still buffered on a fatal signal is appended to the log file
+    CrashHandler::install(&log_queue_, log_writer_, logToFile? QFile::encodeName(logFileName).constData() : NULL);
+
+    // A full ring drops the newest lines and counts them, printing never waits (see setOverflowPolicy)
+    log_queue_.setOverflowPolicy(LogQueue::OverflowPolicy::DropNewest);
+
+    // Lines are produced on the dispatcher thread and rendered once per tick on the GUI thread
+    render_timer_ = new QTimer(this);
+    QObject::connect(render_timer_, &QTimer::timeout, this, &Console::render);
+    render_timer_->start(DEFAULT_RENDER_INTERVAL_MS);
+
+    reported_drops_ = 0;
+    running_ = true;
+    dispatcher_thread_ = new std::thread(&Console::dispatch, this);
 }
 
-Console::~Console()
+void Console::dispatch()
 {
-    // Nothing to clean
+    CrashHandler::ThreadStack alternate_stack;
+    while (running_)
+    {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // Pick up anything printed during shutdown
+    drain();
 }
 
-void Console::print_msg(QString msg)
+void Console::drain()
 {
-    text_edit_->append(msg);
-    QScrollBar *sb = text_edit_->verticalScrollBar();
-    sb->setValue(sb->maximum());
-    if (cout)
+    std::lock_guard<std::mutex> lck(sinks_mtx_);
+
+    LogRecord rec;
+    while (log_queue_.pop(rec))
     {
-        std::cout << msg.toStdString() << std::endl;
+        for (LogSink *sink : sinks_)
+        {
+            if (sink->accepts(rec.level))
+            {
+                sink->write(rec);
+            }
+        }
     }
 
-    if(logToFile)
+    uint64_t drops = log_queue_.droppedCount();
+    uint64_t reported = reported_drops_;
+    if (drops > reported && view_sink_->accepts(LogLevel::Warning))
     {
-        QString timeStamp = dateTime.currentDateTime().toString("[ddd dd:MM:yy-hh:mm:ss]");
-        QFile outFile(logFileName);
-        outFile.open(QIODevice::WriteOnly | QIODevice::Append);
-        QTextStream ts(&outFile);
-        ts << timeStamp << " " << msg << endl;
+        view_sink_->append(QString("Warning: %1 log messages dropped (log ring full)").arg(drops - reported));
+    }
+    reported_drops_ = drops;
+
+    for (LogSink *sink : sinks_)
+    {
+        sink->flush();
     }
 }
 
-void Console::print(std::string msg)
+void Console::render()
 {
-    emit(printer_msg(QString(msg.c_str())));
+    QStringList lines = view_sink_->takeLines();
+    if (!lines.isEmpty())
+    {
+        log_model_->appendLines(lines);
+    }
+
+    if (!filter_.isEmpty())
+    {
+        // Only rows newer than the last query are fetched
+        QStringList matches;
+        filter_seq_ = log_index_->query(filter_, filter_seq_, matches);
+        filter_model_->appendLines(matches);
+        if (!matches.isEmpty())
+        {
+            list_view_->scrollToBottom();
+        }
+    }
+    else if (!lines.isEmpty())
+    {
+        list_view_->scrollToBottom();
+    }
+}
+
+void Console::setFilter(const QString &text)
+{
+    filter_ = LogIndex::Filter::parse(text);
+    filter_seq_ = 0;
+    filter_model_->clear();
+
+    if (filter_.isEmpty())
+    {
+        list_view_->setModel(log_model_);
+    }
+    else
+    {
+        QStringList matches;
+        filter_seq_ = log_index_->query(filter_, filter_seq_, matches);
+        filter_model_->appendLines(matches);
+        list_view_->setModel(filter_model_);
+    }
+    list_view_->scrollToBottom();
+}
+
+void Console::print(const std::string &msg)
+{
+    if (enabled(LogLevel::Info))
+    {
+        log_queue_.push(LogLevel::Info, LogTag::General, msg.data(), msg.size());
+    }
+}
+
+void Console::printf(const char *format, ...)
+{
+    if (!enabled(LogLevel::Info))
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_queue_.vpush(LogLevel::Info, LogTag::General, format, args);
+    va_end(args);
+}
+
+void Console::log(LogLevel level, LogTag tag, const char *format, ...)
+{
+    if (!enabled(level))
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_queue_.vpush(level, tag, format, args);
+    va_end(args);
+}
+
+bool Console::enabled(LogLevel level) const
+{
+    return static_cast<uint8_t>(level) >= min_level_.load(std::memory_order_relaxed);
+}
+
+void Console::addSink(LogSink *sink)
+{
+    {
+        std::lock_guard<std::mutex> lck(sinks_mtx_);
+        sinks_.push_back(sink);
+    }
+    updateMinLevel();
+}
+
+void Console::removeSink(LogSink *sink)
+{
+    {
+        // Waits for an ongoing dispatch, the sink is not used after this returns
+        std::lock_guard<std::mutex> lck(sinks_mtx_);
+        sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+    }
+    updateMinLevel();
+}
+
+void Console::setSinkLevel(Sink sink, LogLevel level)
+{
+    switch (sink)
+    {
+        case Sink::View: setSinkLevel(view_sink_, level); break;
+        case Sink::Stdout: setSinkLevel(stdout_sink_, level); break;
+        case Sink::File: if (file_sink_ != NULL) setSinkLevel(file_sink_, level); break;
+    }
+}
+
+void Console::setSinkLevel(LogSink *sink, LogLevel level)
+{
+    sink->level_ = static_cast<uint8_t>(level);
+    updateMinLevel();
+}
+
+LogLevel Console::sinkLevel(Sink sink) const
+{
+    switch (sink)
+    {
+        case Sink::View: return view_sink_->level();
+        case Sink::Stdout: return stdout_sink_->level();
+        case Sink::File: return (file_sink_ != NULL)? file_sink_->level() : LogLevel::Off;
+    }
+    return LogLevel::Off;
+}
+
+void Console::updateMinLevel()
+{
+    std::lock_guard<std::mutex> lck(sinks_mtx_);
+    uint8_t min_level = static_cast<uint8_t>(LogLevel::Off);
+    for (LogSink *sink : sinks_)
+    {
+        min_level = std::min(min_level, static_cast<uint8_t>(sink->level()));
+    }
+    min_level_ = min_level;
 }
 
 void Console::clear()
 {
-    text_edit_->clear();
+    view_sink_->clear();
+    log_model_->clear();
+}
+
+void Console::setMaxLines(int max_lines)
+{
+    log_model_->setMaxLines(max_lines);
+    filter_model_->setMaxLines(max_lines);
+    view_sink_->setMaxLines(log_model_->maxLines());
+}
+
+void Console::setRenderInterval(int interval_ms)
+{
+    render_timer_->setInterval(interval_ms);
+}
+
+void Console::setOverflowPolicy(LogQueue::OverflowPolicy policy, int block_timeout_us)
+{
+    log_queue_.setOverflowPolicy(policy, block_timeout_us);
+}
+
+void Console::setRotationPolicy(const LogWriter::RotationPolicy &policy)
+{
+    if (log_writer_ != NULL)
+    {
+        log_writer_->setRotationPolicy(policy);
+    }
+}
+
+size_t Console::logRingDepth()
+{
+    return log_queue_.depth();
+}
+
+uint64_t Console::logDroppedCount()
+{
+    return log_queue_.droppedCount();
+}
+
+void Console::resetLogCounters()
+{
+    log_queue_.resetCounters();
+    reported_drops_ = 0;
+}
+
+size_t Console::logQueueDepth()
+{
+    return (log_writer_ != NULL)? log_writer_->queueDepth() : 0;
+}
+
+quint64 Console::logBytesWritten()
+{
+    return (log_writer_ != NULL)? log_writer_->bytesWritten() : 0;
 }
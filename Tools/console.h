@@ -3,38 +3,156 @@
 
 #include <QObject>
 #include <QWidget>
-#include <QTextEdit>
+#include <QListView>
+#include <QTimer>
 #include <iostream>
-#include <QScrollBar>
 #include <QFile>
 #include <QTextStream>
 #include <QDateTime>
+#include <QStringList>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "logwriter.h"
+#include "logqueue.h"
+#include "logmodel.h"
+#include "logformat.h"
+#include "loglevel.h"
+#include "logsink.h"
+#include "logindex.h"
+#include "crashhandler.h"
+
+/**
+ * Compile-time floor for the CONSOLE_* macros (0 = Debug ... 3 = Error). Statements below
+ * it are compiled out, statements above it are skipped at runtime, without evaluating their
+ * arguments, when no sink accepts the level.
+ */
+#ifndef SHARP_LOG_MIN_LEVEL
+#define SHARP_LOG_MIN_LEVEL 0
+#endif
+
+#define CONSOLE_LOG(console, level, tag, ...) \
+    do { \
+        if (static_cast<int>(level) >= SHARP_LOG_MIN_LEVEL && (console)->enabled(level)) \
+            (console)->log(level, tag, __VA_ARGS__); \
+    } while (0)
+
+#define CONSOLE_DEBUG(console, tag, ...)    CONSOLE_LOG(console, LogLevel::Debug, tag, __VA_ARGS__)
+#define CONSOLE_INFO(console, tag, ...)     CONSOLE_LOG(console, LogLevel::Info, tag, __VA_ARGS__)
+#define CONSOLE_WARN(console, tag, ...)     CONSOLE_LOG(console, LogLevel::Warning, tag, __VA_ARGS__)
+#define CONSOLE_ERROR(console, tag, ...)    CONSOLE_LOG(console, LogLevel::Error, tag, __VA_ARGS__)
 
 class Console : public QObject
 {
     Q_OBJECT
 
     public:
-        Console(QTextEdit *text_edit);
-        Console(QTextEdit *text_edit, bool std_cout);
+        // Built-in sinks
+        enum class Sink {
+            View,           // GUI list view
+            Stdout,
+            File
+        };
+
+        Console(QListView *list_view);
+        Console(QListView *list_view, bool std_cout);
         ~Console();
 
-        void print(std::string msg);
+        /**
+         * @brief print     Thread safe. Enqueues msg in the lock-free log ring, never blocks
+         *                  (unless the Block overflow policy is selected) and never allocates.
+         */
+        void print(const std::string &msg);
+
+        /**
+         * @brief printf    printf style print at Info level. The line is formatted directly into
+         *                  the log ring, and only if at least one sink accepts Info.
+         */
+        void printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+        /**
+         * @brief log       printf style print with severity and subsystem tag. Prefer the
+         *                  CONSOLE_* macros, which skip argument evaluation as well.
+         */
+        void log(LogLevel level, LogTag tag, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+        bool enabled(LogLevel level = LogLevel::Info) const;
+
+        /**
+         * @brief addSink   Register an additional sink. The dispatcher thread fans every record
+         *                  out to all registered sinks. The caller keeps ownership and must call
+         *                  removeSink before deleting it.
+         */
+        void addSink(LogSink *sink);
+        void removeSink(LogSink *sink);
+
+        // Per sink thresholds. Records below the threshold are not emitted by that sink
+        void setSinkLevel(Sink sink, LogLevel level);
+        void setSinkLevel(LogSink *sink, LogLevel level);
+        LogLevel sinkLevel(Sink sink) const;
+
         void clear(void);
 
-    signals:
-        void printer_msg(QString msg);
+        /**
+         * @brief setFilter Show only the lines of one mission ID or command (see LogIndex::Filter).
+         *                  An empty filter shows the full log again.
+         */
+        void setFilter(const QString &text);
+
+        // View settings. Lines are rendered once per tick, the view keeps at most max_lines
+        void setMaxLines(int max_lines);
+        void setRenderInterval(int interval_ms);
+
+        void setOverflowPolicy(LogQueue::OverflowPolicy policy, int block_timeout_us = 2000);
+        void setRotationPolicy(const LogWriter::RotationPolicy &policy);
+
+        // Log ring statistics
+        size_t logRingDepth(void);
+        uint64_t logDroppedCount(void);
+        void resetLogCounters(void);
+
+        // File sink statistics
+        size_t logQueueDepth(void);
+        quint64 logBytesWritten(void);
 
     private slots:
-        void print_msg(QString msg);
+        void render(void);
 
     private:
         // Private Attributes
-        QTextEdit *text_edit_;
+        QListView *list_view_;
+        LogModel *log_model_;
+        LogModel *filter_model_;
+        LogIndex::Filter filter_;
+        uint64_t filter_seq_ = 0;
+        QTimer *render_timer_;
+        const int DEFAULT_MAX_LINES = 5000;
+        const int DEFAULT_RENDER_INTERVAL_MS = 30;
         bool cout = true;
         bool logToFile = true;
         QString logFileName = "iCube_SHARP_Log";
-        QDateTime dateTime;
+        LogWriter *log_writer_ = NULL;
+
+        ViewSink *view_sink_ = NULL;
+        StdoutSink *stdout_sink_ = NULL;
+        FileSink *file_sink_ = NULL;
+        LogIndex *log_index_ = NULL;
+        const size_t LOG_INDEX_RETENTION = 20000;
+
+        std::mutex sinks_mtx_;
+        std::vector<LogSink *> sinks_;
+        std::atomic<uint8_t> min_level_;
+
+        LogQueue log_queue_;
+        std::thread *dispatcher_thread_ = NULL;
+        std::atomic<bool> running_;
+        std::atomic<uint64_t> reported_drops_;
+
+        void init(void);
+        void dispatch(void);
+        void drain(void);
+        void updateMinLevel(void);
 };
 
 #endif // CONSOLE_H
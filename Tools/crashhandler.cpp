@@ -0,0 +1,373 @@
+#include "crashhandler.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const int FATAL_SIGNALS[] = {SIGSEGV, SIGABRT};
+    const int SIGNAL_COUNT = sizeof(FATAL_SIGNALS) / sizeof(FATAL_SIGNALS[0]);
+
+    LogQueue *crash_queue = NULL;
+    LogWriter *crash_writer = NULL;
+    char crash_file_name[CrashHandler::FILE_NAME_LENGTH] = "";
+    struct sigaction previous_actions[SIGNAL_COUNT];
+    struct sigaction previous_terminate;
+    bool installed = false;
+    std::atomic_flag handling = ATOMIC_FLAG_INIT;
+
+    // Seqlock protected active task, odd sequence while it is being rewritten
+    std::atomic<uint32_t> task_sequence(0);
+    char task_name[CrashHandler::TASK_LENGTH] = "";
+    std::atomic<int32_t> task_mission_id(LogContext::NO_MISSION);
+
+    // Alternate stack of the installing thread, so a stack overflow can still be reported
+    char alternate_stack[CrashHandler::ThreadStack::STACK_SIZE];
+
+    /**
+     * Async-signal-safe string building, nothing here may allocate, lock or call into libc
+     * formatting.
+     */
+    struct Appender
+    {
+        char *buffer;
+        size_t size;
+        size_t length = 0;
+
+        Appender(char *b, size_t s) : buffer(b), size(s) {}
+
+        void append(const char *data, size_t count)
+        {
+            if (count > size - length) count = size - length;
+            memcpy(buffer + length, data, count);
+            length += count;
+        }
+
+        void append(const char *text)
+        {
+            append(text, strlen(text));
+        }
+
+        void appendNumber(int64_t value, int width = 0)
+        {
+            char digits[24];
+            int count = 0;
+            bool negative = value < 0;
+            uint64_t magnitude = negative? static_cast<uint64_t>(-(value + 1)) + 1 : static_cast<uint64_t>(value);
+            do
+            {
+                digits[count++] = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0 && count < 20);
+            while (count < width && count < 20) digits[count++] = '0';
+            if (negative) digits[count++] = '-';
+            while (count > 0) append(&digits[--count], 1);
+        }
+
+        // UTC "yyyy-mm-dd hh:mm:ss.mmm", localtime is not async-signal-safe
+        void appendTimestamp(int64_t timestamp_ms)
+        {
+            int64_t days = timestamp_ms / 86400000;
+            int64_t ms_of_day = timestamp_ms % 86400000;
+            if (ms_of_day < 0)
+            {
+                ms_of_day += 86400000;
+                days--;
+            }
+
+            // Civil date from days since epoch (H. Hinnant)
+            days += 719468;
+            int64_t era = (days >= 0? days : days - 146096) / 146097;
+            int64_t doe = days - era * 146097;
+            int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            int64_t mp = (5 * doy + 2) / 153;
+            int64_t day = doy - (153 * mp + 2) / 5 + 1;
+            int64_t month = (mp < 10)? mp + 3 : mp - 9;
+            int64_t year = yoe + era * 400 + (month <= 2);
+
+            appendNumber(year, 4);
+            append("-");
+            appendNumber(month, 2);
+            append("-");
+            appendNumber(day, 2);
+            append(" ");
+            appendNumber(ms_of_day / 3600000, 2);
+            append(":");
+            appendNumber(ms_of_day / 60000 % 60, 2);
+            append(":");
+            appendNumber(ms_of_day / 1000 % 60, 2);
+            append(".");
+            appendNumber(ms_of_day % 1000, 3);
+        }
+    };
+
+    const char *signalName(int signal_number)
+    {
+        switch (signal_number)
+        {
+            case SIGSEGV: return "SIGSEGV";
+            case SIGABRT: return "SIGABRT";
+            case SIGTERM: return "SIGTERM";
+            default: return "signal";
+        }
+    }
+}
+
+void CrashHandler::install(LogQueue *queue, LogWriter *writer, const char *file_name)
+{
+    crash_queue = queue;
+    crash_writer = writer;
+    crash_file_name[0] = '\0';
+    if (file_name != NULL)
+    {
+        strncpy(crash_file_name, file_name, FILE_NAME_LENGTH - 1);
+        crash_file_name[FILE_NAME_LENGTH - 1] = '\0';
+    }
+
+    stack_t stack;
+    stack.ss_sp = alternate_stack;
+    stack.ss_size = sizeof(alternate_stack);
+    stack.ss_flags = 0;
+    sigaltstack(&stack, NULL);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = &CrashHandler::handle;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < SIGNAL_COUNT; i++)
+    {
+        sigaction(FATAL_SIGNALS[i], &action, installed? NULL : &previous_actions[i]);
+    }
+    // Not fatal when the host handles it, so it stays installed
+    action.sa_sigaction = &CrashHandler::terminate;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigaction(SIGTERM, &action, installed? NULL : &previous_terminate);
+    installed = true;
+}
+
+void CrashHandler::uninstall()
+{
+    if (!installed)
+    {
+        return;
+    }
+    for (int i = 0; i < SIGNAL_COUNT; i++)
+    {
+        sigaction(FATAL_SIGNALS[i], &previous_actions[i], NULL);
+    }
+    sigaction(SIGTERM, &previous_terminate, NULL);
+    installed = false;
+    crash_queue = NULL;
+    crash_writer = NULL;
+}
+
+void CrashHandler::setActiveTask(const char *task, int32_t mission_id)
+{
+    uint32_t sequence = task_sequence.load(std::memory_order_relaxed);
+    task_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    strncpy(task_name, task, TASK_LENGTH - 1);
+    task_name[TASK_LENGTH - 1] = '\0';
+    task_mission_id.store(mission_id, std::memory_order_relaxed);
+
+    task_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void CrashHandler::clearActiveTask()
+{
+    setActiveTask("", LogContext::NO_MISSION);
+}
+
+void CrashHandler::writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+}
+
+size_t CrashHandler::formatRecord(const LogRecord &rec, char *buffer, size_t size)
+{
+    Appender line(buffer, size);
+    line.append("[");
+    line.appendTimestamp(rec.timestamp_ms);
+    line.append("Z] ");
+    line.append(logLevelName(rec.level));
+    line.append(" ");
+    line.append(logTagName(rec.tag));
+    if (rec.mission_id != LogContext::NO_MISSION || rec.command[0] != '\0')
+    {
+        line.append(" [");
+        line.append(rec.command, strnlen(rec.command, sizeof(rec.command)));
+        line.append(" #");
+        line.appendNumber(rec.mission_id);
+        line.append("]");
+    }
+    line.append(": ");
+    line.append(rec.text, rec.length);
+    line.append("\n");
+    return line.length;
+}
+
+void CrashHandler::handle(int signal_number, siginfo_t *info, void *context)
+{
+    (void)info;
+    (void)context;
+
+    // A second thread crashing meanwhile waits for the first one to terminate the process
+    if (handling.test_and_set())
+    {
+        while (true) pause();
+    }
+
+    int saved_errno = errno;
+    report(signal_number, true);
+    errno = saved_errno;
+
+    // Chain to the host's own handling: its previous action is restored and the signal raised
+    // again, delivered once this handler returns (a fault re-executes and traps again). With no
+    // previous handler that is the default action, which terminates.
+    if (signal_number == SIGTERM)
+    {
+        sigaction(signal_number, &previous_terminate, NULL);
+    }
+    for (int i = 0; i < SIGNAL_COUNT; i++)
+    {
+        if (FATAL_SIGNALS[i] == signal_number)
+        {
+            sigaction(signal_number, &previous_actions[i], NULL);
+        }
+    }
+    raise(signal_number);
+    handling.clear();
+}
+
+void CrashHandler::terminate(int signal_number, siginfo_t *info, void *context)
+{
+    const struct sigaction &previous = previous_terminate;
+    if (!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler == SIG_IGN)
+    {
+        return;
+    }
+    // Default action: the process ends here, handled like a crash
+    if (!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler == SIG_DFL)
+    {
+        handle(signal_number, info, context);
+        return;
+    }
+
+    // The host shuts down gracefully and the dispatcher keeps writing, only mark the moment.
+    // The handler stays installed, a later crash is still reported.
+    if (handling.test_and_set())
+    {
+        return;
+    }
+    int saved_errno = errno;
+    report(signal_number, false);
+    errno = saved_errno;
+    handling.clear();
+
+    if (previous.sa_flags & SA_SIGINFO)
+    {
+        previous.sa_sigaction(signal_number, info, context);
+    }
+    else
+    {
+        previous.sa_handler(signal_number);
+    }
+}
+
+void CrashHandler::report(int signal_number, bool flush)
+{
+    int fd = (crash_file_name[0] != '\0')? open(crash_file_name, O_WRONLY | O_APPEND | O_CREAT, 0644) : -1;
+    int out = (fd >= 0)? fd : STDERR_FILENO;
+
+    // Active task, retried if the mission thread was rewriting it
+    char task[TASK_LENGTH];
+    int32_t mission_id = LogContext::NO_MISSION;
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        uint32_t before = task_sequence.load(std::memory_order_acquire);
+        memcpy(task, task_name, sizeof(task));
+        mission_id = task_mission_id.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((before & 1) == 0 && task_sequence.load(std::memory_order_relaxed) == before) break;
+    }
+    task[TASK_LENGTH - 1] = '\0';
+
+    char buffer[LogRecord::MAX_LENGTH + 160];
+    Appender banner(buffer, sizeof(buffer));
+    banner.append(flush? "*** Fatal signal " : "*** Signal ");
+    banner.appendNumber(signal_number);
+    banner.append(" (");
+    banner.append(signalName(signal_number));
+    banner.append("), active task: ");
+    banner.append(task[0] != '\0'? task : "none");
+    banner.append(", mission ID: ");
+    banner.appendNumber(mission_id);
+    banner.append(flush? ". Flushing log\n" : ". Passed to the host's handler\n");
+    writeAll(out, buffer, banner.length);
+    if (out != STDERR_FILENO)
+    {
+        writeAll(STDERR_FILENO, buffer, banner.length);
+    }
+
+    if (flush)
+    {
+        // Older lines first: writer buffer, then the ring. Only read, the dispatcher stays its consumer.
+        if (crash_writer != NULL)
+        {
+            crash_writer->writePending(out);
+        }
+        if (crash_queue != NULL)
+        {
+            LogRecord rec;
+            for (size_t offset = 0; offset < crash_queue->capacity() && crash_queue->peek(offset, rec); offset++)
+            {
+                writeAll(out, buffer, formatRecord(rec, buffer, sizeof(buffer)));
+            }
+        }
+
+        static const char END[] = "*** End of crash log\n";
+        writeAll(out, END, sizeof(END) - 1);
+    }
+    if (fd >= 0)
+    {
+        if (flush) fsync(fd);
+        close(fd);
+    }
+}
+
+CrashHandler::ThreadStack::ThreadStack() :
+    stack_(new char[STACK_SIZE])
+{
+    stack_t stack;
+    stack.ss_sp = stack_;
+    stack.ss_size = STACK_SIZE;
+    stack.ss_flags = 0;
+    sigaltstack(&stack, NULL);
+}
+
+CrashHandler::ThreadStack::~ThreadStack()
+{
+    stack_t current;
+    if (sigaltstack(NULL, &current) == 0 && current.ss_sp == stack_)
+    {
+        stack_t disable;
+        memset(&disable, 0, sizeof(disable));
+        disable.ss_flags = SS_DISABLE;
+        sigaltstack(&disable, NULL);
+    }
+    delete[] stack_;
+}
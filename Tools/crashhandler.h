@@ -0,0 +1,72 @@
+#ifndef CRASHHANDLER_H
+#define CRASHHANDLER_H
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include "logqueue.h"
+#include "logwriter.h"
+
+/**
+ * @brief The CrashHandler class
+ * Fatal signal handler of the buffered log pipeline. On SIGSEGV or SIGABRT it appends the active
+ * robot task and mission ID, the lines still buffered by the LogWriter and the records still in
+ * the log ring to the log file, using only async-signal-safe calls, then hands the signal on to
+ * the handler the host had installed before (or the default action).
+ * SIGTERM is only fatal without a host handler and is then handled the same way. With one, the
+ * host shuts down gracefully: only a banner is written, the host's handler is called and the
+ * handlers stay installed.
+ * Process wide, installed by Console. Best effort: records the dispatcher is formatting at the
+ * moment of the crash may be written twice. A stack overflow is only reported on threads that
+ * hold a ThreadStack (the installing one and the plugin's own threads), not on paho's.
+ */
+class CrashHandler
+{
+    public:
+        static const size_t TASK_LENGTH = 64;
+        static const size_t FILE_NAME_LENGTH = 256;
+
+        /**
+         * @brief install   Register the handlers
+         * @param queue     Log ring drained on a fatal signal
+         * @param writer    File sink whose pending buffer is written out first, can be NULL
+         * @param file_name Log file appended to, stderr when NULL or if it cannot be opened
+         */
+        static void install(LogQueue *queue, LogWriter *writer, const char *file_name);
+        static void uninstall(void);
+
+        /**
+         * @brief setActiveTask  Task and robot mission reported on a crash. Called by the
+         *                       mission thread, never allocates.
+         */
+        static void setActiveTask(const char *task, int32_t mission_id);
+        static void clearActiveTask(void);
+
+        /**
+         * @brief The ThreadStack class  Alternate signal stack of the calling thread for its
+         * lifetime (sigaltstack is per thread). Held at the top of each long-lived thread.
+         */
+        class ThreadStack
+        {
+            public:
+                static const size_t STACK_SIZE = 64 * 1024;
+
+                ThreadStack();
+                ~ThreadStack();
+
+            private:
+                ThreadStack(const ThreadStack &);
+                ThreadStack &operator=(const ThreadStack &);
+
+                char *stack_;
+        };
+
+    private:
+        static void handle(int signal_number, siginfo_t *info, void *context);
+        static void terminate(int signal_number, siginfo_t *info, void *context);
+        static void report(int signal_number, bool flush);
+        static void writeAll(int fd, const char *data, size_t length);
+        static size_t formatRecord(const LogRecord &rec, char *buffer, size_t size);
+};
+
+#endif // CRASHHANDLER_H
@@ -0,0 +1,145 @@
+#include "deliverytracker.h"
+#include <algorithm>
+
+DeliveryTracker::DeliveryTracker(size_t window, int timeout_ms, int max_retries)
+{
+    window_ = (window > 0)? window : 1;
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+    max_retries_ = max_retries;
+}
+
+void DeliveryTracker::setWindow(size_t window)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    window_ = (window > 0)? window : 1;
+}
+
+void DeliveryTracker::setTimeout(int timeout_ms)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+}
+
+void DeliveryTracker::setMaxRetries(int max_retries)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    max_retries_ = max_retries;
+}
+
+bool DeliveryTracker::hasCapacity()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return in_flight_.size() < window_;
+}
+
+void DeliveryTracker::deferred()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    totals_.deferred++;
+}
+
+uint64_t DeliveryTracker::begin(const OutboundMessage &msg)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    uint64_t seq = next_seq_++;
+    Delivery &delivery = in_flight_[seq];
+    delivery.msg = msg;
+    delivery.sent = Clock::now();
+
+    totals_.sent++;
+    totals_.max_in_flight = std::max(totals_.max_in_flight, in_flight_.size());
+    return seq;
+}
+
+void DeliveryTracker::cancel(uint64_t seq)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (in_flight_.erase(seq) > 0)
+    {
+        totals_.sent--;
+    }
+}
+
+bool DeliveryTracker::complete(uint64_t seq, OutboundMessage &delivered)
+{
+    Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = in_flight_.find(seq);
+    if (it == in_flight_.end())
+    {
+        // Released by expire already, a durable message still has to leave the journal
+        auto late = late_.find(seq);
+        if (late != late_.end())
+        {
+            delivered = late->second;
+            late_.erase(late);
+            totals_.acked++;
+        }
+        return false;
+    }
+    latency_.add(std::chrono::duration<double, std::milli>(now - it->second.sent).count());
+    delivered = it->second.msg;
+    in_flight_.erase(it);
+    totals_.acked++;
+    return true;
+}
+
+bool DeliveryTracker::fail(uint64_t seq, OutboundMessage &retry)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = in_flight_.find(seq);
+    if (it != in_flight_.end())
+    {
+        retry = it->second.msg;
+        in_flight_.erase(it);
+    }
+    else
+    {
+        auto late = late_.find(seq);
+        if (late == late_.end())
+        {
+            return false;
+        }
+        retry = late->second;
+        late_.erase(late);
+    }
+
+    retry.failed_attempts++;
+    if (retry.failed_attempts > max_retries_ && retry.journal_id == 0)
+    {
+        totals_.failed++;
+        return false;
+    }
+    totals_.retried++;
+    return true;
+}
+
+size_t DeliveryTracker::expire()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Clock::time_point now = Clock::now();
+    size_t released = 0;
+    while (!in_flight_.empty() && now - in_flight_.begin()->second.sent > timeout_)
+    {
+        // paho may still deliver it, the slot is only freed so publishing does not stall
+        if (in_flight_.begin()->second.msg.journal_id != 0)
+        {
+            late_[in_flight_.begin()->first] = in_flight_.begin()->second.msg;
+        }
+        in_flight_.erase(in_flight_.begin());
+        totals_.timed_out++;
+        released++;
+    }
+    return released;
+}
+
+DeliveryTracker::Stats DeliveryTracker::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = totals_;
+    stats.in_flight = in_flight_.size();
+    stats.window = window_;
+    stats.latency = latency_.summary();
+    return stats;
+}
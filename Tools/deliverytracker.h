@@ -0,0 +1,107 @@
+#ifndef DELIVERYTRACKER_H
+#define DELIVERYTRACKER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include "latencywindow.h"
+#include "outboundbuffer.h"
+
+/**
+ * @brief The DeliveryTracker class
+ * Bounded in-flight window of QoS 1 publishes waiting for their PUBACK. A slot is taken per
+ * publish and released on acknowledgement, failure or timeout; while all slots are taken the
+ * publisher holds further messages back (backpressure). Publish to PUBACK latency goes into a
+ * rolling histogram, failed deliveries are handed back for a limited number of retries.
+ * Thread safe: begin from the publishing thread, complete/fail from the paho callbacks.
+ */
+class DeliveryTracker
+{
+    public:
+        struct Stats
+        {
+            size_t in_flight = 0;
+            size_t max_in_flight = 0;
+            size_t window = 0;
+            uint64_t sent = 0;
+            uint64_t acked = 0;
+            uint64_t failed = 0;            // Given up after the retries
+            uint64_t retried = 0;
+            uint64_t timed_out = 0;         // Slot released without a PUBACK
+            uint64_t deferred = 0;          // Publishes held back by a full window
+            LatencyWindow::Summary latency;
+        };
+
+        /**
+         * @brief DeliveryTracker
+         * @param window        Maximum number of unacknowledged publishes
+         * @param timeout_ms    Slot of a publish without PUBACK after this long is released
+         * @param max_retries   Republish attempts of a failed delivery
+         */
+        DeliveryTracker(size_t window = 32, int timeout_ms = 10000, int max_retries = 3);
+
+        void setWindow(size_t window);
+        void setTimeout(int timeout_ms);
+        void setMaxRetries(int max_retries);
+
+        bool hasCapacity(void);
+        void deferred(void);
+
+        /**
+         * @brief begin     Take a slot for msg
+         * @return Sequence number identifying the delivery in complete/fail/cancel
+         */
+        uint64_t begin(const OutboundMessage &msg);
+
+        /**
+         * @brief cancel    Release the slot of a publish that was never handed to the client
+         */
+        void cancel(uint64_t seq);
+
+        /**
+         * @brief complete  Release the slot of an acknowledged delivery
+         * @param delivered The acknowledged message, also set for a durable message whose slot
+         *                  expired before the PUBACK came
+         * @return false if the slot was released already
+         */
+        bool complete(uint64_t seq, OutboundMessage &delivered);
+
+        /**
+         * @brief fail      Release the slot of a failed delivery
+         * @param retry     The message to publish again
+         * @return true if the message should be retried. Durable messages always are, past
+         *              max_retries too.
+         */
+        bool fail(uint64_t seq, OutboundMessage &retry);
+
+        /**
+         * @brief expire    Release slots waiting longer than the timeout
+         * @return Number of slots released
+         */
+        size_t expire(void);
+
+        Stats stats(void);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Delivery
+        {
+            OutboundMessage msg;
+            Clock::time_point sent;
+        };
+
+        std::mutex mtx_;
+        size_t window_;
+        std::chrono::milliseconds timeout_;
+        int max_retries_;
+
+        uint64_t next_seq_ = 1;
+        std::map<uint64_t, Delivery> in_flight_;    // Ordered by sequence, hence by send time
+        std::map<uint64_t, OutboundMessage> late_;  // Durable deliveries released by expire, still awaited
+        LatencyWindow latency_;
+        Stats totals_;
+};
+
+#endif // DELIVERYTRACKER_H
@@ -0,0 +1,96 @@
+#ifndef FLIGHTRECORD_H
+#define FLIGHTRECORD_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * On-disk layout of the flight recorder ring file, shared by FlightRecorder and the
+ * flight_decoder tool.
+ *
+ *  [FileHeader][padding up to records_offset][Record 0][Record 1]...[Record capacity-1]
+ *
+ * A record in slot (n % capacity) is valid when its sequence equals n + 1.
+ */
+namespace flight
+{
+
+const uint32_t FILE_MAGIC = 0x52464853;     // "SHFR"
+const uint32_t FILE_VERSION = 2;
+const size_t NAME_LENGTH = 64;
+const size_t MAX_NAMES = 256;
+const uint16_t NO_NAME = 0xFFFF;
+
+enum EventType : uint16_t {
+    kEventMissionStart = 1,     // name: command, status: bed id (or -1)
+    kEventMissionEnd = 2,       // name: command, status: 1 success / 0 failure
+    kEventTaskStart = 3,        // name: task file, mission_id: robot mission id
+    kEventTaskResult = 4,       // name: task file, status: robot mission status (-1 timeout, -2 mismatch)
+    kEventRobotResponse = 5,    // mission_id: responding mission, status: robot mission status
+    kEventMqttIn = 6,           // name: topic
+    kEventMqttOut = 7,          // name: topic, status: payload length, detail_hash: payload
+    kEventStateChange = 8       // name: new robot state
+};
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t records_offset;
+    uint32_t name_count;
+    uint64_t write_index;                   // Total records ever written
+    char names[MAX_NAMES][NAME_LENGTH];     // Interned task / topic strings
+};
+
+struct Record
+{
+    uint64_t timestamp_us;      // Microseconds since epoch
+    uint64_t sequence;          // Slot sequence, written last
+    int32_t mission_id;
+    int32_t status;
+    uint16_t event;
+    uint16_t name_index;
+    uint16_t reserved;
+    uint32_t detail_hash;       // hashDetail of the detail (payload), 0 if none
+};
+
+/**
+ * FNV-1a of a detail. Payloads are only identified, never stored: they would fill the name
+ * table, and may be binary.
+ */
+inline uint32_t hashDetail(const char *data, size_t length)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline const char *eventName(uint16_t event)
+{
+    switch (event)
+    {
+        case kEventMissionStart: return "mission_start";
+        case kEventMissionEnd: return "mission_end";
+        case kEventTaskStart: return "task_start";
+        case kEventTaskResult: return "task_result";
+        case kEventRobotResponse: return "robot_response";
+        case kEventMqttIn: return "mqtt_in";
+        case kEventMqttOut: return "mqtt_out";
+        case kEventStateChange: return "state_change";
+        default: return "unknown";
+    }
+}
+
+} // flight
+
+#endif // FLIGHTRECORD_H
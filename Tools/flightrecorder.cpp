@@ -0,0 +1,196 @@
+#include "flightrecorder.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+FlightRecorder::FlightRecorder(std::string file_name, uint32_t capacity)
+{
+    file_name_ = file_name;
+    for (size_t i = 0; i < NAME_SLOTS; i++)
+    {
+        name_slots_[i] = 0;
+    }
+    if (!open(capacity))
+    {
+        std::cerr << "FlightRecorder: Cannot map " << file_name_ << ". Recording disabled" << std::endl;
+    }
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    if (mapping_ != NULL)
+    {
+        msync(mapping_, mapping_size_, MS_ASYNC);
+        munmap(mapping_, mapping_size_);
+    }
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+bool FlightRecorder::open(uint32_t capacity)
+{
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t records_offset = (sizeof(flight::FileHeader) + page - 1) / page * page;
+    mapping_size_ = records_offset + static_cast<size_t>(capacity) * sizeof(flight::Record);
+
+    fd_ = ::open(file_name_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    bool reuse = false;
+    if (fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) == mapping_size_)
+    {
+        flight::FileHeader existing;
+        reuse = pread(fd_, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing)) &&
+                existing.magic == flight::FILE_MAGIC && existing.version == flight::FILE_VERSION &&
+                existing.record_size == sizeof(flight::Record) && existing.capacity == capacity &&
+                existing.records_offset == records_offset;
+    }
+    if (!reuse && ftruncate(fd_, static_cast<off_t>(mapping_size_)) != 0)
+    {
+        return false;
+    }
+
+    mapping_ = mmap(NULL, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping_ == MAP_FAILED)
+    {
+        mapping_ = NULL;
+        return false;
+    }
+    header_ = static_cast<flight::FileHeader *>(mapping_);
+    records_ = reinterpret_cast<flight::Record *>(static_cast<char *>(mapping_) + records_offset);
+
+    if (reuse)
+    {
+        // Continue after the previous run, keeping its name table
+        for (uint32_t i = 0; i < header_->name_count && i < flight::MAX_NAMES; i++)
+        {
+            insertSlot(flight::hashDetail(header_->names[i], strnlen(header_->names[i], flight::NAME_LENGTH)), static_cast<uint16_t>(i));
+        }
+    }
+    else
+    {
+        memset(mapping_, 0, mapping_size_);
+        header_->version = flight::FILE_VERSION;
+        header_->record_size = sizeof(flight::Record);
+        header_->capacity = capacity;
+        header_->records_offset = static_cast<uint32_t>(records_offset);
+        header_->name_count = 0;
+        header_->write_index = 0;
+        // Magic last, a half initialized file is never mistaken for a valid one
+        __atomic_store_n(&header_->magic, flight::FILE_MAGIC, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+bool FlightRecorder::isOpen() const
+{
+    return header_ != NULL;
+}
+
+uint16_t FlightRecorder::nameIndex(const std::string &name)
+{
+    if (name.empty())
+    {
+        return flight::NO_NAME;
+    }
+
+    // Truncated to the table's width, without trailing newlines or blanks
+    const char *key = name.data();
+    size_t length = std::min(name.size(), flight::NAME_LENGTH - 1);
+    while (length > 0 && (key[length - 1] == '\n' || key[length - 1] == ' '))
+    {
+        length--;
+    }
+    uint32_t hash = flight::hashDetail(key, length);
+    uint16_t index = findName(key, length, hash);
+    if (index != flight::NO_NAME)
+    {
+        return index;
+    }
+
+    std::lock_guard<std::mutex> lck(names_mtx_);
+    index = findName(key, length, hash);
+    if (index != flight::NO_NAME)
+    {
+        return index;
+    }
+    uint32_t count = header_->name_count;
+    if (count >= flight::MAX_NAMES)
+    {
+        return flight::NO_NAME;
+    }
+    memcpy(header_->names[count], key, length);
+    header_->names[count][length] = '\0';
+    __atomic_store_n(&header_->name_count, count + 1, __ATOMIC_RELEASE);
+    insertSlot(hash, static_cast<uint16_t>(count));
+    return static_cast<uint16_t>(count);
+}
+
+uint16_t FlightRecorder::findName(const char *key, size_t length, uint32_t hash)
+{
+    for (size_t i = 0; i < NAME_SLOTS; i++)
+    {
+        uint32_t slot = name_slots_[(hash + i) % NAME_SLOTS].load(std::memory_order_acquire);
+        if (slot == 0)
+        {
+            return flight::NO_NAME;
+        }
+        const char *stored = header_->names[slot - 1];
+        if (strnlen(stored, flight::NAME_LENGTH) == length && memcmp(stored, key, length) == 0)
+        {
+            return static_cast<uint16_t>(slot - 1);
+        }
+    }
+    return flight::NO_NAME;
+}
+
+void FlightRecorder::insertSlot(uint32_t hash, uint16_t index)
+{
+    // MAX_NAMES is well below NAME_SLOTS, a free slot always exists
+    size_t i = hash % NAME_SLOTS;
+    while (name_slots_[i].load(std::memory_order_relaxed) != 0)
+    {
+        i = (i + 1) % NAME_SLOTS;
+    }
+    name_slots_[i].store(static_cast<uint32_t>(index) + 1, std::memory_order_release);
+}
+
+void FlightRecorder::record(flight::EventType event, int32_t mission_id, const std::string &name,
+                            int32_t status, const std::string &detail)
+{
+    if (header_ == NULL)
+    {
+        return;
+    }
+
+    uint64_t index = __atomic_fetch_add(&header_->write_index, 1, __ATOMIC_RELAXED);
+    flight::Record *rec = &records_[index % header_->capacity];
+
+    // Invalidate the slot while it is rewritten
+    __atomic_store_n(&rec->sequence, 0, __ATOMIC_RELAXED);
+    rec->timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    rec->mission_id = mission_id;
+    rec->status = status;
+    rec->event = event;
+    rec->name_index = nameIndex(name);
+    rec->reserved = 0;
+    rec->detail_hash = flight::hashDetail(detail.data(), detail.size());
+    __atomic_store_n(&rec->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t FlightRecorder::recordCount() const
+{
+    return (header_ != NULL)? __atomic_load_n(&header_->write_index, __ATOMIC_RELAXED) : 0;
+}
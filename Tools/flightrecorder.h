@@ -0,0 +1,58 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <atomic>
+#include <string>
+#include <mutex>
+#include "flightrecord.h"
+
+/**
+ * @brief The FlightRecorder class
+ * Always-on binary event log. Records are written into a fixed size memory-mapped ring file
+ * (MAP_SHARED), so everything recorded up to the moment of a host process crash is kept by the
+ * kernel. Names (tasks, topics) are interned in the file's name table, details (payloads) are
+ * only hashed. Recording is lock-free except for the first use of each name. Decode the file
+ * with the flight_decoder tool.
+ */
+class FlightRecorder
+{
+    public:
+        /**
+         * @brief FlightRecorder
+         * @param file_name     Ring file. Reused (and appended to) if its layout matches
+         * @param capacity      Number of records in the ring
+         */
+        FlightRecorder(std::string file_name, uint32_t capacity = 65536);
+        ~FlightRecorder();
+
+        bool isOpen(void) const;
+
+        /**
+         * @brief record    detail is stored as its flight::hashDetail only
+         */
+        void record(flight::EventType event, int32_t mission_id, const std::string &name,
+                    int32_t status = 0, const std::string &detail = std::string());
+
+        uint64_t recordCount(void) const;
+
+    private:
+        std::string file_name_;
+        int fd_ = -1;
+        void *mapping_ = NULL;
+        size_t mapping_size_ = 0;
+        flight::FileHeader *header_ = NULL;
+        flight::Record *records_ = NULL;
+
+        // Open addressing hash of the name table, name index + 1 per slot (0 empty). Slots are
+        // published after their name, so lookups need no lock; inserts take names_mtx_.
+        static const size_t NAME_SLOTS = 1024;
+        std::atomic<uint32_t> name_slots_[NAME_SLOTS];
+        std::mutex names_mtx_;
+
+        bool open(uint32_t capacity);
+        uint16_t nameIndex(const std::string &name);
+        uint16_t findName(const char *key, size_t length, uint32_t hash);
+        void insertSlot(uint32_t hash, uint16_t index);
+};
+
+#endif // FLIGHTRECORDER_H
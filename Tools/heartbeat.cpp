@@ -0,0 +1,105 @@
+#include "heartbeat.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const char SEQ_KEY[] = "\"seq\":";
+}
+
+Heartbeat::Heartbeat(size_t window, int timeout_ms) :
+    rtt_(window)
+{
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+}
+
+void Heartbeat::setTimeout(int timeout_ms)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    timeout_ = std::chrono::milliseconds(timeout_ms);
+}
+
+std::string Heartbeat::ping()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Clock::time_point now = Clock::now();
+    expire(now);
+
+    uint64_t seq = next_seq_++;
+    outstanding_[seq] = now;
+    totals_.sent++;
+
+    char payload[48];
+    int length = snprintf(payload, sizeof(payload), "{\"seq\":%llu}\n", static_cast<unsigned long long>(seq));
+    return std::string(payload, (length > 0)? static_cast<size_t>(length) : 0);
+}
+
+bool Heartbeat::onEcho(const std::string &payload)
+{
+    Clock::time_point now = Clock::now();
+
+    const char *key = strstr(payload.c_str(), SEQ_KEY);
+    if (key == NULL)
+    {
+        return false;
+    }
+    uint64_t seq = strtoull(key + sizeof(SEQ_KEY) - 1, NULL, 10);
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = outstanding_.find(seq);
+    if (it == outstanding_.end())
+    {
+        // Already counted as missed, or a ping of an earlier connection
+        return false;
+    }
+    double rtt_ms = std::chrono::duration<double, std::milli>(now - it->second).count();
+    outstanding_.erase(it);
+
+    rtt_.add(rtt_ms);
+    totals_.received++;
+    totals_.consecutive_missed = 0;
+    return true;
+}
+
+void Heartbeat::reset()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    outstanding_.clear();
+    totals_.consecutive_missed = 0;
+}
+
+int Heartbeat::consecutiveMissed()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    expire(Clock::now());
+    return totals_.consecutive_missed;
+}
+
+Heartbeat::Stats Heartbeat::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    expire(Clock::now());
+
+    Stats stats = totals_;
+    LatencyWindow::Summary rtt = rtt_.summary();
+    stats.samples = rtt.samples;
+    stats.last_ms = rtt.last_ms;
+    stats.p50_ms = rtt.p50_ms;
+    stats.p95_ms = rtt.p95_ms;
+    stats.max_ms = rtt.max_ms;
+    std::copy(rtt.histogram, rtt.histogram + BUCKET_COUNT, stats.histogram);
+    return stats;
+}
+
+void Heartbeat::expire(Clock::time_point now)
+{
+    // Outstanding pings are ordered by sequence, hence by send time
+    while (!outstanding_.empty() && now - outstanding_.begin()->second > timeout_)
+    {
+        outstanding_.erase(outstanding_.begin());
+        totals_.missed++;
+        totals_.consecutive_missed++;
+    }
+}
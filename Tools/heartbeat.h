@@ -0,0 +1,85 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include "latencywindow.h"
+
+/**
+ * @brief The Heartbeat class
+ * Application level MQTT ping. Each ping carries a sequence number and is published on a topic
+ * the client is subscribed to, so the broker echoes it back. Round trip times are kept over a
+ * rolling window and bucketed into a histogram, pings without an echo within the timeout count
+ * as missed. Thread safe: ping from a timer, onEcho from the paho callback.
+ */
+class Heartbeat
+{
+    public:
+        static const int BUCKET_COUNT = LatencyWindow::BUCKET_COUNT;
+
+        struct Stats
+        {
+            size_t samples = 0;
+            double last_ms = 0;
+            double p50_ms = 0;
+            double p95_ms = 0;
+            double max_ms = 0;
+            uint64_t sent = 0;
+            uint64_t received = 0;
+            uint64_t missed = 0;
+            int consecutive_missed = 0;
+            uint32_t histogram[BUCKET_COUNT] = {};  // Samples per bucket, see bucketLimit
+        };
+
+        /**
+         * @brief Heartbeat
+         * @param window        Number of round trips kept for the statistics
+         * @param timeout_ms    Ping without echo after this long is counted as missed
+         */
+        Heartbeat(size_t window = 120, int timeout_ms = 3000);
+
+        void setTimeout(int timeout_ms);
+
+        /**
+         * @brief ping      Payload of the next ping. Expires outstanding pings first.
+         */
+        std::string ping(void);
+
+        /**
+         * @brief onEcho    Record the round trip of an echoed ping
+         * @return false if payload is not an outstanding ping
+         */
+        bool onEcho(const std::string &payload);
+
+        /**
+         * @brief reset     Forget outstanding pings, after a reconnect
+         */
+        void reset(void);
+
+        int consecutiveMissed(void);
+        Stats stats(void);
+
+        /**
+         * @brief bucketLimit   Upper bound (ms) of histogram bucket, -1 for the last (open) bucket
+         */
+        static int bucketLimit(int bucket) { return LatencyWindow::bucketLimit(bucket); }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        std::mutex mtx_;
+        std::chrono::milliseconds timeout_;
+
+        uint64_t next_seq_ = 1;
+        std::map<uint64_t, Clock::time_point> outstanding_;
+
+        LatencyWindow rtt_;
+        Stats totals_;
+
+        void expire(Clock::time_point now);
+};
+
+#endif // HEARTBEAT_H
@@ -0,0 +1,59 @@
+#include "latencywindow.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    const int BUCKET_LIMITS_MS[LatencyWindow::BUCKET_COUNT - 1] = {5, 10, 20, 50, 100, 200, 500, 1000, 2000};
+}
+
+LatencyWindow::LatencyWindow(size_t window)
+{
+    window_ = (window > 0)? window : 1;
+}
+
+void LatencyWindow::add(double ms)
+{
+    samples_.push_back(ms);
+    histogram_[bucket(ms)]++;
+    if (samples_.size() > window_)
+    {
+        histogram_[bucket(samples_.front())]--;
+        samples_.pop_front();
+    }
+    last_ms_ = ms;
+}
+
+LatencyWindow::Summary LatencyWindow::summary() const
+{
+    Summary summary;
+    summary.samples = samples_.size();
+    summary.last_ms = last_ms_;
+    std::copy(histogram_, histogram_ + BUCKET_COUNT, summary.histogram);
+    if (!samples_.empty())
+    {
+        std::vector<double> sorted(samples_.begin(), samples_.end());
+        std::sort(sorted.begin(), sorted.end());
+        summary.p50_ms = sorted[(sorted.size() - 1) / 2];
+        summary.p95_ms = sorted[(sorted.size() - 1) * 95 / 100];
+        summary.max_ms = sorted.back();
+    }
+    return summary;
+}
+
+int LatencyWindow::bucketLimit(int bucket)
+{
+    return (bucket >= 0 && bucket < BUCKET_COUNT - 1)? BUCKET_LIMITS_MS[bucket] : -1;
+}
+
+int LatencyWindow::bucket(double ms)
+{
+    for (int i = 0; i < BUCKET_COUNT - 1; i++)
+    {
+        if (ms < BUCKET_LIMITS_MS[i])
+        {
+            return i;
+        }
+    }
+    return BUCKET_COUNT - 1;
+}
@@ -0,0 +1,47 @@
+#ifndef LATENCYWINDOW_H
+#define LATENCYWINDOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+/**
+ * @brief The LatencyWindow class
+ * Rolling window of latency samples with a fixed bucket histogram and percentiles.
+ * Not thread safe, owners lock around it.
+ */
+class LatencyWindow
+{
+    public:
+        static const int BUCKET_COUNT = 10;
+
+        struct Summary
+        {
+            size_t samples = 0;
+            double last_ms = 0;
+            double p50_ms = 0;
+            double p95_ms = 0;
+            double max_ms = 0;
+            uint32_t histogram[BUCKET_COUNT] = {};  // Samples per bucket, see bucketLimit
+        };
+
+        LatencyWindow(size_t window = 120);
+
+        void add(double ms);
+        Summary summary(void) const;
+
+        /**
+         * @brief bucketLimit   Upper bound (ms) of histogram bucket, -1 for the last (open) bucket
+         */
+        static int bucketLimit(int bucket);
+
+    private:
+        size_t window_;
+        std::deque<double> samples_;
+        uint32_t histogram_[BUCKET_COUNT] = {};
+        double last_ms_ = 0;
+
+        static int bucket(double ms);
+};
+
+#endif // LATENCYWINDOW_H
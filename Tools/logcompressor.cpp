@@ -0,0 +1,149 @@
+#include "logcompressor.h"
+#include "crashhandler.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <zlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <iostream>
+
+LogCompressor::LogCompressor(QString active_file)
+{
+    active_file_ = active_file;
+    compressed_ = 0;
+    deleted_ = 0;
+
+    worker_thread_ = new std::thread(&LogCompressor::run, this);
+}
+
+LogCompressor::~LogCompressor()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    cond_.notify_all();
+    worker_thread_->join();
+    delete worker_thread_;
+}
+
+void LogCompressor::setPolicy(Compression compression, int retention)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    compression_ = compression;
+    retention_ = retention;
+}
+
+void LogCompressor::submit(QString rotated_file)
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        jobs_.push_back(rotated_file);
+    }
+    cond_.notify_one();
+}
+
+uint64_t LogCompressor::compressedCount() const
+{
+    return compressed_;
+}
+
+uint64_t LogCompressor::deletedCount() const
+{
+    return deleted_;
+}
+
+void LogCompressor::run()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    // Lowest scheduling priority for this thread only (Linux per-thread nice value)
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+    while (true)
+    {
+        QString job;
+        Compression compression;
+        int retention;
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            cond_.wait(lck, [&]{return !running_ || !jobs_.empty();});
+            // Pending jobs are finished before shutting down
+            if (jobs_.empty())
+            {
+                return;
+            }
+            job = jobs_.front();
+            jobs_.pop_front();
+            compression = compression_;
+            retention = retention_;
+        }
+
+        if (compression == Compression::Gzip && compress(job))
+        {
+            QFile::remove(job);
+            compressed_++;
+        }
+        enforceRetention(retention);
+    }
+}
+
+bool LogCompressor::compress(const QString &file_name)
+{
+    QFile in(file_name);
+    if (!in.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QString gz_name = file_name + ".gz";
+    gzFile out = gzopen(gz_name.toLocal8Bit().constData(), "wb6");
+    if (out == NULL)
+    {
+        std::cerr << "LogCompressor: Cannot create " << gz_name.toStdString() << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    char buffer[64 * 1024];
+    qint64 length;
+    while ((length = in.read(buffer, sizeof(buffer))) > 0)
+    {
+        if (gzwrite(out, buffer, static_cast<unsigned>(length)) != length)
+        {
+            success = false;
+            break;
+        }
+    }
+    if (gzclose(out) != Z_OK || length < 0)
+    {
+        success = false;
+    }
+
+    if (!success)
+    {
+        QFile::remove(gz_name);
+    }
+    return success;
+}
+
+void LogCompressor::enforceRetention(int retention)
+{
+    if (retention <= 0)
+    {
+        return;
+    }
+
+    // Rotated files carry a sortable timestamp suffix, oldest first
+    QFileInfo active(active_file_);
+    QDir dir = active.absoluteDir();
+    QStringList rotated = dir.entryList(QStringList() << active.fileName() + ".*", QDir::Files, QDir::Name);
+    for (int i = 0; i < rotated.size() - retention; i++)
+    {
+        if (dir.remove(rotated.at(i)))
+        {
+            deleted_++;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef LOGCOMPRESSOR_H
+#define LOGCOMPRESSOR_H
+
+#include <QString>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * @brief The LogCompressor class
+ * Low priority background worker for rotated log files. Compresses each rotated file
+ * (gzip) and deletes the oldest rotated files beyond the retention count.
+ */
+class LogCompressor
+{
+    public:
+        enum class Compression {
+            None,
+            Gzip
+        };
+
+        /**
+         * @brief LogCompressor
+         * @param active_file   Active log file path, rotated files are named <active_file>.<suffix>
+         */
+        LogCompressor(QString active_file);
+        ~LogCompressor();
+
+        void setPolicy(Compression compression, int retention);
+        void submit(QString rotated_file);
+
+        uint64_t compressedCount(void) const;
+        uint64_t deletedCount(void) const;
+
+    private:
+        QString active_file_;
+        Compression compression_ = Compression::Gzip;
+        int retention_ = 7;
+
+        std::mutex mtx_;
+        std::condition_variable cond_;
+        std::deque<QString> jobs_;
+        bool running_ = true;
+
+        std::atomic<uint64_t> compressed_;
+        std::atomic<uint64_t> deleted_;
+
+        std::thread *worker_thread_ = NULL;
+
+        void run();
+        bool compress(const QString &file_name);
+        void enforceRetention(int retention);
+};
+
+#endif // LOGCOMPRESSOR_H
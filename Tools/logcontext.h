@@ -0,0 +1,47 @@
+#ifndef LOGCONTEXT_H
+#define LOGCONTEXT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+/**
+ * @brief The LogContext struct
+ * Per thread mission context, copied into every log record printed from that thread.
+ * CommandProcessor sets it while it runs a command, other threads keep the empty context.
+ */
+struct LogContext
+{
+    static const size_t COMMAND_LENGTH = 32;
+    static const int32_t NO_MISSION = -1;
+
+    int32_t mission_id = NO_MISSION;
+    char command[COMMAND_LENGTH] = "";
+
+    static LogContext &current(void)
+    {
+        static thread_local LogContext context;
+        return context;
+    }
+
+    static void setCommand(const char *command)
+    {
+        LogContext &context = current();
+        strncpy(context.command, command, COMMAND_LENGTH - 1);
+        context.command[COMMAND_LENGTH - 1] = '\0';
+    }
+
+    static void setMission(int32_t mission_id)
+    {
+        current().mission_id = mission_id;
+    }
+
+    static void clear(void)
+    {
+        LogContext &context = current();
+        context.mission_id = NO_MISSION;
+        context.command[0] = '\0';
+    }
+};
+
+#endif // LOGCONTEXT_H
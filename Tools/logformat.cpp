@@ -0,0 +1,45 @@
+#include "logformat.h"
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+
+LogFormatter::LogFormatter()
+{
+    prefix_[0] = '\0';
+}
+
+const char *LogFormatter::timestamp(int64_t timestamp_ms, size_t &length)
+{
+    int64_t second = (timestamp_ms >= 0)? timestamp_ms / 1000 : (timestamp_ms - 999) / 1000;
+    if (second != cached_second_)
+    {
+        // Same layout as QDateTime "[ddd dd:MM:yy-hh:mm:ss]"
+        time_t t = static_cast<time_t>(second);
+        struct tm local;
+        localtime_r(&t, &local);
+        prefix_length_ = strftime(prefix_, sizeof(prefix_), "[%a %d:%m:%y-%H:%M:%S]", &local);
+        cached_second_ = second;
+    }
+    length = prefix_length_;
+    return prefix_;
+}
+
+void LogFormatter::formatLine(const LogRecord &rec, std::string &out)
+{
+    size_t prefix_length;
+    const char *prefix = timestamp(rec.timestamp_ms, prefix_length);
+    out.append(prefix, prefix_length);
+    out.push_back(' ');
+    out.append(logLevelName(rec.level));
+    out.push_back(' ');
+    out.append(logTagName(rec.tag));
+    if (rec.mission_id != LogContext::NO_MISSION || rec.command[0] != '\0')
+    {
+        char context[64];
+        int length = snprintf(context, sizeof(context), " [%s #%d]", rec.command, rec.mission_id);
+        if (length > 0) out.append(context, std::min(static_cast<size_t>(length), sizeof(context) - 1));
+    }
+    out.append(": ", 2);
+    out.append(rec.text, rec.length);
+    out.push_back('\n');
+}
@@ -0,0 +1,37 @@
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "logqueue.h"
+
+/**
+ * @brief The LogFormatter class
+ * Builds file log lines ("[ddd dd:MM:yy-hh:mm:ss] LEVEL tag: message") into a caller owned,
+ * reusable buffer. The timestamp prefix is formatted once per second and cached.
+ * Not thread safe, each consumer owns its formatter.
+ */
+class LogFormatter
+{
+    public:
+        LogFormatter();
+
+        /**
+         * @brief timestamp     Cached prefix for the second containing timestamp_ms
+         */
+        const char *timestamp(int64_t timestamp_ms, size_t &length);
+
+        /**
+         * @brief formatLine    Append "<timestamp> <LEVEL> <tag> [<command> #<mission>]: <text>\n" to out. Does not allocate
+         *                      once out has grown to its working size.
+         */
+        void formatLine(const LogRecord &rec, std::string &out);
+
+    private:
+        int64_t cached_second_ = -1;
+        char prefix_[48];
+        size_t prefix_length_ = 0;
+};
+
+#endif // LOGFORMAT_H
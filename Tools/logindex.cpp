@@ -0,0 +1,155 @@
+#include "logindex.h"
+#include <algorithm>
+
+LogIndex::Filter LogIndex::Filter::parse(const QString &text)
+{
+    Filter filter;
+    QString value = text.trimmed();
+    if (value.isEmpty())
+    {
+        return filter;
+    }
+
+    bool is_number = false;
+    if (value.startsWith("mission:"))
+    {
+        filter.mission_id = value.mid(8).trimmed().toInt(&is_number);
+        if (!is_number) filter.mission_id = LogContext::NO_MISSION;
+    }
+    else if (value.startsWith("cmd:"))
+    {
+        filter.command = value.mid(4).trimmed().toStdString();
+    }
+    else
+    {
+        int mission_id = value.toInt(&is_number);
+        if (is_number) filter.mission_id = mission_id;
+        else filter.command = value.toStdString();
+    }
+    return filter;
+}
+
+LogIndex::LogIndex(LogLevel level, size_t retention) : LogSink(level)
+{
+    retention_ = (retention > 0)? retention : 1;
+    text_.resize(static_cast<int>(retention_));
+    mission_.resize(static_cast<int>(retention_));
+    command_.resize(static_cast<int>(retention_));
+}
+
+uint16_t LogIndex::commandId(const char *command)
+{
+    if (command[0] == '\0')
+    {
+        return NO_COMMAND;
+    }
+
+    auto it = command_ids_.find(command);
+    if (it != command_ids_.end())
+    {
+        return it->second;
+    }
+    if (command_ids_.size() >= NO_COMMAND)
+    {
+        return NO_COMMAND;
+    }
+    uint16_t id = static_cast<uint16_t>(command_ids_.size());
+    command_ids_[command] = id;
+    return id;
+}
+
+void LogIndex::evictOldest()
+{
+    int row = static_cast<int>(first_seq_ % retention_);
+
+    // Index lists are ordered by sequence, the evicted row is at their front
+    auto mission = by_mission_.find(mission_[row]);
+    if (mission != by_mission_.end())
+    {
+        mission->second.pop_front();
+        if (mission->second.empty()) by_mission_.erase(mission);
+    }
+    auto command = by_command_.find(command_[row]);
+    if (command != by_command_.end())
+    {
+        command->second.pop_front();
+        if (command->second.empty()) by_command_.erase(command);
+    }
+
+    text_[row].clear();
+    first_seq_++;
+}
+
+void LogIndex::write(const LogRecord &rec)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (next_seq_ - first_seq_ >= retention_)
+    {
+        evictOldest();
+    }
+
+    uint64_t seq = next_seq_++;
+    int row = static_cast<int>(seq % retention_);
+    text_[row] = QString::fromUtf8(rec.text, rec.length);
+    mission_[row] = rec.mission_id;
+    command_[row] = commandId(rec.command);
+
+    if (rec.mission_id != LogContext::NO_MISSION)
+    {
+        by_mission_[rec.mission_id].push_back(seq);
+    }
+    if (command_[row] != NO_COMMAND)
+    {
+        by_command_[command_[row]].push_back(seq);
+    }
+}
+
+uint64_t LogIndex::query(const Filter &filter, uint64_t after_seq, QStringList &lines)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    uint64_t last_seq = next_seq_ - 1;
+    if (filter.isEmpty())
+    {
+        return last_seq;
+    }
+
+    const SeqList *mission_rows = NULL;
+    const SeqList *command_rows = NULL;
+    if (filter.mission_id != LogContext::NO_MISSION)
+    {
+        auto it = by_mission_.find(filter.mission_id);
+        if (it == by_mission_.end()) return last_seq;
+        mission_rows = &it->second;
+    }
+    if (!filter.command.empty())
+    {
+        auto id = command_ids_.find(filter.command);
+        if (id == command_ids_.end()) return last_seq;
+        auto it = by_command_.find(id->second);
+        if (it == by_command_.end()) return last_seq;
+        command_rows = &it->second;
+    }
+
+    // Walk the shorter list, check the other column for combined filters
+    const SeqList *rows = mission_rows;
+    if (rows == NULL || (command_rows != NULL && command_rows->size() < rows->size()))
+    {
+        rows = command_rows;
+    }
+    uint16_t command_id = (command_rows != NULL)? command_ids_[filter.command] : NO_COMMAND;
+
+    for (auto it = std::upper_bound(rows->begin(), rows->end(), after_seq); it != rows->end(); ++it)
+    {
+        int row = static_cast<int>(*it % retention_);
+        if (mission_rows != NULL && mission_[row] != filter.mission_id) continue;
+        if (command_rows != NULL && command_[row] != command_id) continue;
+        lines.append(text_[row]);
+    }
+    return last_seq;
+}
+
+size_t LogIndex::size()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return next_seq_ - first_seq_;
+}
@@ -0,0 +1,72 @@
+#ifndef LOGINDEX_H
+#define LOGINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "logsink.h"
+
+/**
+ * @brief The LogIndex class
+ * In-memory log of the most recent records, stored column-wise and indexed by mission ID
+ * and by command. A lookup only touches the matching rows, so filtering the view never
+ * scans the whole log. Written by the Console dispatcher, queried from the GUI thread.
+ */
+class LogIndex : public LogSink
+{
+    public:
+        struct Filter
+        {
+            int32_t mission_id = LogContext::NO_MISSION;
+            std::string command;
+
+            bool isEmpty(void) const { return mission_id == LogContext::NO_MISSION && command.empty(); }
+
+            /**
+             * @brief parse   "mission:<id>", "cmd:<command>", a bare number (mission ID)
+             *                or a bare word (command)
+             */
+            static Filter parse(const QString &text);
+        };
+
+        LogIndex(LogLevel level, size_t retention = 20000);
+
+        void write(const LogRecord &rec) Q_DECL_OVERRIDE;
+
+        /**
+         * @brief query     Append lines matching filter with a sequence number above after_seq
+         * @return          Sequence number of the last row examined, pass it back as after_seq
+         *                  to fetch only newer rows
+         */
+        uint64_t query(const Filter &filter, uint64_t after_seq, QStringList &lines);
+
+        size_t size(void);
+
+    private:
+        typedef std::deque<uint64_t> SeqList;
+
+        size_t retention_;
+        std::mutex mtx_;
+
+        // Column storage, circular, row of sequence s lives at (s % retention_)
+        QVector<QString> text_;
+        QVector<int32_t> mission_;
+        QVector<uint16_t> command_;
+        uint64_t first_seq_ = 1;        // Oldest retained sequence
+        uint64_t next_seq_ = 1;
+
+        std::unordered_map<std::string, uint16_t> command_ids_;
+        std::unordered_map<int32_t, SeqList> by_mission_;
+        std::unordered_map<uint16_t, SeqList> by_command_;
+
+        const uint16_t NO_COMMAND = 0xFFFF;
+
+        uint16_t commandId(const char *command);
+        void evictOldest(void);
+};
+
+#endif // LOGINDEX_H
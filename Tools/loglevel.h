@@ -0,0 +1,60 @@
+#ifndef LOGLEVEL_H
+#define LOGLEVEL_H
+
+#include <cstdint>
+#include <string>
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+    Off = 4         // Sink threshold only, disables the sink
+};
+
+enum class LogTag : uint8_t {
+    General = 0,
+    Gui = 1,
+    Mission = 2,
+    Mqtt = 3
+};
+
+inline const char *logLevelName(LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warning: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        default: return "OFF";
+    }
+}
+
+inline const char *logTagName(LogTag tag)
+{
+    switch (tag)
+    {
+        case LogTag::Gui: return "gui";
+        case LogTag::Mission: return "mission";
+        case LogTag::Mqtt: return "mqtt";
+        default: return "general";
+    }
+}
+
+/**
+ * @brief logLevelFromString    Parse "debug", "info", "warning", "error" or "off"
+ * @return false if name is not a level, level is left untouched
+ */
+inline bool logLevelFromString(const std::string &name, LogLevel &level)
+{
+    if (name == "debug")                            level = LogLevel::Debug;
+    else if (name == "info")                        level = LogLevel::Info;
+    else if (name == "warning" || name == "warn")   level = LogLevel::Warning;
+    else if (name == "error")                       level = LogLevel::Error;
+    else if (name == "off")                         level = LogLevel::Off;
+    else return false;
+    return true;
+}
+
+#endif // LOGLEVEL_H
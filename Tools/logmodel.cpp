@@ -0,0 +1,103 @@
+#include "logmodel.h"
+
+LogModel::LogModel(int max_lines, QObject *parent) : QAbstractListModel(parent)
+{
+    max_lines_ = (max_lines > 0)? max_lines : 1;
+    lines_.resize(max_lines_);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid()? 0 : count_;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= count_)
+    {
+        return QVariant();
+    }
+
+    switch (role)
+    {
+        case Qt::DisplayRole: return lineAt(index.row());
+        case Qt::ForegroundRole: return text_color_;
+        default: return QVariant();
+    }
+}
+
+const QString &LogModel::lineAt(int row) const
+{
+    return lines_[(first_ + row) % max_lines_];
+}
+
+void LogModel::appendLines(const QStringList &lines)
+{
+    if (lines.isEmpty())
+    {
+        return;
+    }
+
+    // Only the newest max_lines_ of an oversized batch can be displayed
+    int skip = (lines.size() > max_lines_)? lines.size() - max_lines_ : 0;
+    int incoming = lines.size() - skip;
+
+    // Evict the oldest rows in one operation
+    int overflow = count_ + incoming - max_lines_;
+    if (overflow > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        for (int i = 0; i < overflow; i++)
+        {
+            lines_[(first_ + i) % max_lines_].clear();
+        }
+        first_ = (first_ + overflow) % max_lines_;
+        count_ -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count_, count_ + incoming - 1);
+    for (int i = skip; i < lines.size(); i++)
+    {
+        lines_[(first_ + count_) % max_lines_] = lines.at(i);
+        count_++;
+    }
+    endInsertRows();
+}
+
+void LogModel::setMaxLines(int max_lines)
+{
+    if (max_lines <= 0 || max_lines == max_lines_)
+    {
+        return;
+    }
+
+    // Keep the newest lines that still fit
+    int keep = qMin(count_, max_lines);
+    QVector<QString> lines(max_lines);
+    for (int i = 0; i < keep; i++)
+    {
+        lines[i] = lineAt(count_ - keep + i);
+    }
+
+    beginResetModel();
+    lines_ = lines;
+    max_lines_ = max_lines;
+    first_ = 0;
+    count_ = keep;
+    endResetModel();
+}
+
+int LogModel::maxLines() const
+{
+    return max_lines_;
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    lines_.fill(QString());
+    first_ = 0;
+    count_ = 0;
+    endResetModel();
+}
@@ -0,0 +1,43 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QVector>
+#include <QColor>
+
+/**
+ * @brief The LogModel class
+ * Bounded list model backing the console view. Lines are kept in a circular buffer,
+ * once max_lines is reached the oldest lines are evicted, so memory and per-line cost
+ * stay constant regardless of how long the plugin runs.
+ */
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    public:
+        LogModel(int max_lines, QObject *parent = 0);
+
+        int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+        QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+        /**
+         * @brief appendLines   Insert a batch of lines in one model operation
+         */
+        void appendLines(const QStringList &lines);
+        void setMaxLines(int max_lines);
+        int maxLines(void) const;
+        void clear(void);
+
+    private:
+        QVector<QString> lines_;
+        int max_lines_;
+        int first_ = 0;         // Index of the oldest line in lines_
+        int count_ = 0;
+        QColor text_color_ = QColor(0, 255, 0);
+
+        const QString &lineAt(int row) const;
+};
+
+#endif // LOGMODEL_H
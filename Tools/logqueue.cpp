@@ -0,0 +1,237 @@
+#include "logqueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+
+LogQueue::LogQueue(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+
+    slots_ = new Slot[size];
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; i++)
+    {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+    policy_ = static_cast<int>(OverflowPolicy::DropNewest);
+    block_timeout_us_ = 2000;
+    dropped_ = 0;
+    truncated_ = 0;
+    pushed_ = 0;
+}
+
+LogQueue::~LogQueue()
+{
+    delete[] slots_;
+}
+
+void LogQueue::setOverflowPolicy(OverflowPolicy policy, int block_timeout_us)
+{
+    policy_ = static_cast<int>(policy);
+    block_timeout_us_ = block_timeout_us;
+}
+
+LogQueue::Slot *LogQueue::acquire(size_t &pos)
+{
+    std::chrono::steady_clock::time_point deadline;
+    bool waiting = false;
+
+    pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Slot *slot = &slots_[pos & mask_];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            // Slot free, try to claim it
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return slot;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Ring full
+            if (policy_.load(std::memory_order_relaxed) == static_cast<int>(OverflowPolicy::DropNewest))
+            {
+                return NULL;
+            }
+            if (!waiting)
+            {
+                waiting = true;
+                deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(block_timeout_us_.load());
+            }
+            else if (std::chrono::steady_clock::now() > deadline)
+            {
+                return NULL;
+            }
+            std::this_thread::yield();
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            // Another producer claimed this slot
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void LogQueue::publish(Slot *slot, size_t pos)
+{
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool LogQueue::push(LogLevel level, LogTag tag, const char *msg, size_t length)
+{
+    size_t pos;
+    Slot *slot = acquire(pos);
+    if (slot == NULL)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (length > LogRecord::MAX_LENGTH)
+    {
+        length = LogRecord::MAX_LENGTH;
+        truncated_.fetch_add(1, std::memory_order_relaxed);
+    }
+    LogRecord &rec = slot->record;
+    rec.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.level = level;
+    rec.tag = tag;
+    const LogContext &context = LogContext::current();
+    rec.mission_id = context.mission_id;
+    memcpy(rec.command, context.command, sizeof(rec.command));
+    rec.length = static_cast<uint32_t>(length);
+    memcpy(rec.text, msg, length);
+
+    publish(slot, pos);
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogQueue::vpush(LogLevel level, LogTag tag, const char *format, va_list args)
+{
+    size_t pos;
+    Slot *slot = acquire(pos);
+    if (slot == NULL)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    LogRecord &rec = slot->record;
+    rec.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.level = level;
+    rec.tag = tag;
+    const LogContext &context = LogContext::current();
+    rec.mission_id = context.mission_id;
+    memcpy(rec.command, context.command, sizeof(rec.command));
+    int length = vsnprintf(rec.text, LogRecord::MAX_LENGTH, format, args);
+    if (length < 0)
+    {
+        length = 0;
+    }
+    else if (static_cast<size_t>(length) >= LogRecord::MAX_LENGTH)
+    {
+        // vsnprintf reserves the last byte for the terminator
+        length = LogRecord::MAX_LENGTH - 1;
+        truncated_.fetch_add(1, std::memory_order_relaxed);
+    }
+    rec.length = static_cast<uint32_t>(length);
+
+    publish(slot, pos);
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogQueue::pop(LogRecord &rec)
+{
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Slot *slot = &slots_[pos & mask_];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+    {
+        // Empty, or the producer of this slot has not published yet
+        return false;
+    }
+
+    rec.timestamp_ms = slot->record.timestamp_ms;
+    rec.level = slot->record.level;
+    rec.tag = slot->record.tag;
+    rec.mission_id = slot->record.mission_id;
+    memcpy(rec.command, slot->record.command, sizeof(rec.command));
+    rec.length = slot->record.length;
+    memcpy(rec.text, slot->record.text, rec.length);
+
+    // Hand the slot back to producers for the next lap
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogQueue::peek(size_t offset, LogRecord &rec) const
+{
+    size_t pos = dequeue_pos_.load(std::memory_order_acquire) + offset;
+    const Slot *slot = &slots_[pos & mask_];
+    if (slot->sequence.load(std::memory_order_acquire) != pos + 1)
+    {
+        return false;
+    }
+
+    rec.timestamp_ms = slot->record.timestamp_ms;
+    rec.level = slot->record.level;
+    rec.tag = slot->record.tag;
+    rec.mission_id = slot->record.mission_id;
+    memcpy(rec.command, slot->record.command, sizeof(rec.command));
+    rec.length = std::min<uint32_t>(slot->record.length, LogRecord::MAX_LENGTH);
+    memcpy(rec.text, slot->record.text, rec.length);
+
+    // Consumed and possibly rewritten by a producer meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->sequence.load(std::memory_order_relaxed) == pos + 1;
+}
+
+size_t LogQueue::depth() const
+{
+    size_t enq = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t deq = dequeue_pos_.load(std::memory_order_relaxed);
+    return (enq > deq)? enq - deq : 0;
+}
+
+size_t LogQueue::capacity() const
+{
+    return mask_ + 1;
+}
+
+uint64_t LogQueue::droppedCount() const
+{
+    return dropped_;
+}
+
+uint64_t LogQueue::truncatedCount() const
+{
+    return truncated_;
+}
+
+uint64_t LogQueue::pushedCount() const
+{
+    return pushed_;
+}
+
+void LogQueue::resetCounters()
+{
+    dropped_ = 0;
+    truncated_ = 0;
+    pushed_ = 0;
+}
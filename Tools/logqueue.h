@@ -0,0 +1,108 @@
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdarg>
+#include "loglevel.h"
+#include "logcontext.h"
+
+/**
+ * @brief The LogRecord struct
+ * Fixed size, preallocated log record. Messages longer than MAX_LENGTH are truncated.
+ */
+struct LogRecord
+{
+    static const size_t MAX_LENGTH = 480;
+
+    int64_t timestamp_ms;
+    LogLevel level;
+    LogTag tag;
+    int32_t mission_id;                         // LogContext of the printing thread
+    char command[LogContext::COMMAND_LENGTH];
+    uint32_t length;
+    char text[MAX_LENGTH];
+};
+
+/**
+ * @brief The LogQueue class
+ * Bounded lock-free multi-producer / single-consumer ring of preallocated LogRecords.
+ * Producers enqueue in constant time without allocating (sequence-numbered slots),
+ * a single consumer drains the ring in order.
+ */
+class LogQueue
+{
+    public:
+        enum class OverflowPolicy {
+            DropNewest,     // Reject the incoming record when the ring is full
+            Block           // Spin until a slot frees up, drop after the block timeout
+        };
+
+        /**
+         * @brief LogQueue
+         * @param capacity  Number of preallocated records (rounded up to a power of two)
+         */
+        LogQueue(size_t capacity = 1024);
+        ~LogQueue();
+
+        void setOverflowPolicy(OverflowPolicy policy, int block_timeout_us = 2000);
+
+        /**
+         * @brief push       Copy msg into a free slot. Never allocates.
+         * @return false if the record was dropped
+         */
+        bool push(LogLevel level, LogTag tag, const char *msg, size_t length);
+
+        /**
+         * @brief vpush      printf style. Formats straight into the claimed slot, never allocates.
+         * @return false if the record was dropped
+         */
+        bool vpush(LogLevel level, LogTag tag, const char *format, va_list args);
+
+        /**
+         * @brief pop        Consumer side. Copy the oldest record into rec.
+         * @return false if the ring is empty
+         */
+        bool pop(LogRecord &rec);
+
+        /**
+         * @brief peek       Copy the record offset places after the oldest one, without consuming
+         *                   it. Lock-free and async-signal-safe, for the crash handler: the
+         *                   consumer keeps its ring to itself.
+         * @return false past the newest record, or if the record was consumed during the copy
+         */
+        bool peek(size_t offset, LogRecord &rec) const;
+
+        size_t depth(void) const;
+        size_t capacity(void) const;
+        uint64_t droppedCount(void) const;
+        uint64_t truncatedCount(void) const;
+        uint64_t pushedCount(void) const;
+        void resetCounters(void);
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            LogRecord record;
+        };
+
+        Slot *acquire(size_t &pos);
+        void publish(Slot *slot, size_t pos);
+
+        Slot *slots_;
+        size_t mask_;
+
+        // Producer and consumer indices kept on separate cache lines
+        alignas(64) std::atomic<size_t> enqueue_pos_;
+        alignas(64) std::atomic<size_t> dequeue_pos_;
+
+        alignas(64) std::atomic<int> policy_;
+        std::atomic<int> block_timeout_us_;
+        std::atomic<uint64_t> dropped_;
+        std::atomic<uint64_t> truncated_;
+        std::atomic<uint64_t> pushed_;
+};
+
+#endif // LOGQUEUE_H
@@ -0,0 +1,98 @@
+#include "logsink.h"
+#include <iostream>
+
+StdoutSink::StdoutSink(LogLevel level) : LogSink(level)
+{
+    buffer_.reserve(16 * 1024);
+}
+
+void StdoutSink::write(const LogRecord &rec)
+{
+    buffer_.append(rec.text, rec.length);
+    buffer_.push_back('\n');
+}
+
+void StdoutSink::flush()
+{
+    // One write and flush per batch instead of std::endl per line
+    if (!buffer_.empty())
+    {
+        std::cout.write(buffer_.data(), buffer_.size());
+        std::cout.flush();
+        buffer_.clear();
+    }
+}
+
+FileSink::FileSink(LogWriter *writer, LogLevel level) : LogSink(level)
+{
+    writer_ = writer;
+    buffer_.reserve(64 * 1024);
+}
+
+void FileSink::write(const LogRecord &rec)
+{
+    formatter_.formatLine(rec, buffer_);
+    lines_++;
+}
+
+void FileSink::flush()
+{
+    if (lines_ > 0)
+    {
+        writer_->write(buffer_.data(), buffer_.size(), lines_);
+        buffer_.clear();
+        lines_ = 0;
+    }
+}
+
+ViewSink::ViewSink(LogLevel level, int max_lines) : LogSink(level)
+{
+    max_lines_ = max_lines;
+}
+
+void ViewSink::write(const LogRecord &rec)
+{
+    batch_.append(QString::fromUtf8(rec.text, rec.length));
+}
+
+void ViewSink::append(const QString &line)
+{
+    batch_.append(line);
+}
+
+void ViewSink::flush()
+{
+    if (batch_.isEmpty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    pending_.append(batch_);
+    batch_.clear();
+    // Lines beyond the view capacity would be evicted on the next render anyway
+    int excess = pending_.size() - max_lines_;
+    if (excess > 0)
+    {
+        pending_.erase(pending_.begin(), pending_.begin() + excess);
+    }
+}
+
+QStringList ViewSink::takeLines()
+{
+    QStringList lines;
+    std::lock_guard<std::mutex> lck(mtx_);
+    lines.swap(pending_);
+    return lines;
+}
+
+void ViewSink::clear()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    pending_.clear();
+}
+
+void ViewSink::setMaxLines(int max_lines)
+{
+    max_lines_ = max_lines;
+}
@@ -0,0 +1,92 @@
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <QStringList>
+#include "loglevel.h"
+#include "logqueue.h"
+#include "logformat.h"
+#include "logwriter.h"
+
+/**
+ * @brief The LogSink class
+ * Output registered with Console. write() and flush() are only called from the Console
+ * dispatcher thread, flush() once after every dispatched batch.
+ */
+class LogSink
+{
+    public:
+        LogSink(LogLevel level = LogLevel::Info) : level_(static_cast<uint8_t>(level)) {}
+        virtual ~LogSink() {}
+
+        virtual void write(const LogRecord &rec) = 0;
+        virtual void flush(void) {}
+
+        LogLevel level(void) const { return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
+        bool accepts(LogLevel level) const { return static_cast<uint8_t>(level) >= level_.load(std::memory_order_relaxed); }
+
+    private:
+        // Changed through Console::setSinkLevel, which keeps the global threshold in sync
+        friend class Console;
+        std::atomic<uint8_t> level_;
+};
+
+/**
+ * @brief The StdoutSink class
+ * Buffers a batch and writes it to std::cout with a single flush.
+ */
+class StdoutSink : public LogSink
+{
+    public:
+        StdoutSink(LogLevel level);
+        void write(const LogRecord &rec) Q_DECL_OVERRIDE;
+        void flush(void) Q_DECL_OVERRIDE;
+
+    private:
+        std::string buffer_;
+};
+
+/**
+ * @brief The FileSink class
+ * Formats records with a cached timestamp prefix and hands each batch to a LogWriter.
+ */
+class FileSink : public LogSink
+{
+    public:
+        FileSink(LogWriter *writer, LogLevel level);
+        void write(const LogRecord &rec) Q_DECL_OVERRIDE;
+        void flush(void) Q_DECL_OVERRIDE;
+
+    private:
+        LogWriter *writer_;
+        LogFormatter formatter_;
+        std::string buffer_;
+        size_t lines_ = 0;
+};
+
+/**
+ * @brief The ViewSink class
+ * Stages lines for the GUI, which collects them once per render tick with takeLines().
+ */
+class ViewSink : public LogSink
+{
+    public:
+        ViewSink(LogLevel level, int max_lines);
+        void write(const LogRecord &rec) Q_DECL_OVERRIDE;
+        void flush(void) Q_DECL_OVERRIDE;
+
+        void append(const QString &line);
+        QStringList takeLines(void);
+        void clear(void);
+        void setMaxLines(int max_lines);
+
+    private:
+        QStringList batch_;
+        std::mutex mtx_;
+        QStringList pending_;
+        std::atomic<int> max_lines_;
+};
+
+#endif // LOGSINK_H
@@ -0,0 +1,225 @@
+#include "logwriter.h"
+#include "crashhandler.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+
+LogWriter::LogWriter(QString file_name, size_t flush_bytes, int flush_interval_ms) :
+    compressor_(file_name)
+{
+    file_name_ = file_name;
+    flush_bytes_ = flush_bytes;
+    flush_interval_ = std::chrono::milliseconds(flush_interval_ms);
+    queue_depth_ = 0;
+    pending_busy_ = false;
+    bytes_written_ = 0;
+    rotations_ = 0;
+    pending_.reserve(2 * flush_bytes_);
+
+    writer_thread_ = new std::thread(&LogWriter::run, this);
+}
+
+LogWriter::~LogWriter()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    // Writer thread drains everything still buffered before exiting
+    writer_thread_->join();
+    delete writer_thread_;
+}
+
+void LogWriter::write(const char *data, size_t length, size_t lines)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        lockPending();
+        pending_.append(data, length);
+        unlockPending();
+        pending_lines_ += lines;
+        queue_depth_ = pending_lines_;
+        wake = (pending_.size() >= flush_bytes_);
+    }
+    if (wake)
+    {
+        cond_.notify_one();
+    }
+}
+
+void LogWriter::flush()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        flush_requested_ = true;
+    }
+    cond_.notify_one();
+}
+
+void LogWriter::setRotationPolicy(const RotationPolicy &policy)
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        policy_ = policy;
+    }
+    compressor_.setPolicy(policy.compression, policy.retention);
+}
+
+void LogWriter::lockPending()
+{
+    // Called with mtx_ held, only ever contended by the crash path
+    while (pending_busy_.exchange(true, std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void LogWriter::unlockPending()
+{
+    pending_busy_.store(false, std::memory_order_release);
+}
+
+void LogWriter::writePending(int fd)
+{
+    // Never wait here, the flag owner may be the crashed thread. No mutex: not async-signal-safe.
+    if (pending_busy_.exchange(true, std::memory_order_acquire))
+    {
+        return;
+    }
+
+    const char *data = pending_.data();
+    size_t length = pending_.size();
+    while (length > 0)
+    {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+    // Keeps the capacity, nothing is freed. The line count is the dispatcher's, under mtx_.
+    pending_.clear();
+    unlockPending();
+}
+
+size_t LogWriter::queueDepth() const
+{
+    return queue_depth_;
+}
+
+quint64 LogWriter::bytesWritten() const
+{
+    return bytes_written_;
+}
+
+uint64_t LogWriter::rotationCount() const
+{
+    return rotations_;
+}
+
+bool LogWriter::open(QFile &file, qint64 &size, QDate &day)
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        std::cerr << "LogWriter: Cannot open log file " << file_name_.toStdString() << std::endl;
+        return false;
+    }
+    size = file.size();
+    // An existing file keeps the day it was last written, so a restart still rotates it
+    day = (size > 0)? QFileInfo(file).lastModified().date() : QDate::currentDate();
+    return true;
+}
+
+void LogWriter::rotate(QFile &file, const QDate &day)
+{
+    file.close();
+
+    // Named after the day the file holds, not the day it is rotated on
+    QString rotated = file_name_ + "." + day.toString("yyyyMMdd") + "-" +
+            QFileInfo(file_name_).lastModified().time().toString("hhmmss");
+    QString target = rotated;
+    for (int i = 1; QFile::exists(target) || QFile::exists(target + ".gz"); i++)
+    {
+        target = rotated + "." + QString::number(i);
+    }
+
+    if (QFile::rename(file_name_, target))
+    {
+        rotations_++;
+        compressor_.submit(target);
+    }
+    else
+    {
+        std::cerr << "LogWriter: Cannot rotate log file " << file_name_.toStdString() << std::endl;
+    }
+}
+
+void LogWriter::run()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    QFile outFile(file_name_);
+    qint64 file_size = 0;
+    QDate file_day;
+    open(outFile, file_size, file_day);
+
+    // Swapped with pending_ on every write cycle, both keep their capacity
+    std::string batch;
+    batch.reserve(2 * flush_bytes_);
+    bool running = true;
+    RotationPolicy policy;
+    while (running)
+    {
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            cond_.wait_for(lck, flush_interval_, [&]{return !running_ || flush_requested_ || pending_.size() >= flush_bytes_;});
+            policy = policy_;
+
+            // Size threshold, explicit flush, shutdown or flush interval elapsed
+            lockPending();
+            batch.swap(pending_);
+            unlockPending();
+            pending_lines_ = 0;
+            queue_depth_ = 0;
+            flush_requested_ = false;
+            running = running_;
+        }
+
+        if (batch.empty())
+        {
+            continue;
+        }
+
+        // Only this thread owns the file, producers keep appending to pending_ meanwhile
+        bool size_limit = policy.max_bytes > 0 && file_size > 0 &&
+                file_size + static_cast<qint64>(batch.size()) > policy.max_bytes;
+        bool day_changed = policy.daily && file_size > 0 && file_day != QDate::currentDate();
+        if (outFile.isOpen() && (size_limit || day_changed))
+        {
+            rotate(outFile, file_day);
+        }
+        if (!outFile.isOpen() && !open(outFile, file_size, file_day))
+        {
+            batch.clear();
+            continue;
+        }
+
+        qint64 written = outFile.write(batch.data(), batch.size());
+        outFile.flush();
+        if (written > 0)
+        {
+            bytes_written_ += written;
+            file_size += written;
+        }
+        batch.clear();
+    }
+
+    outFile.close();
+}
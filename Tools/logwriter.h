@@ -0,0 +1,90 @@
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QString>
+#include <QFile>
+#include <QDate>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "logcompressor.h"
+
+/**
+ * @brief The LogWriter class
+ * Background file sink used by Console. The log file is kept open by a dedicated
+ * writer thread, lines are buffered and written out when the size or time threshold
+ * is reached, and on shutdown. Callers never touch the disk.
+ * The file is rotated by size and by day. Rotation happens on the writer thread between two
+ * writes, compression and retention are handed to a low priority LogCompressor.
+ */
+class LogWriter
+{
+    public:
+        struct RotationPolicy
+        {
+            qint64 max_bytes = 10 * 1024 * 1024;    // 0 disables size based rotation
+            bool daily = true;
+            int retention = 7;                      // Rotated files kept, 0 keeps all
+            LogCompressor::Compression compression = LogCompressor::Compression::Gzip;
+        };
+
+        /**
+         * @brief LogWriter
+         * @param file_name         Log file path (opened in append mode)
+         * @param flush_bytes       Buffered bytes that trigger a write
+         * @param flush_interval_ms Maximum time a buffered line waits before being written
+         */
+        LogWriter(QString file_name, size_t flush_bytes = 16 * 1024, int flush_interval_ms = 500);
+        ~LogWriter();
+
+        /**
+         * @brief write     Append preformatted data (one or more complete lines) to the buffer
+         * @param lines     Number of lines contained in data, for queue depth reporting
+         */
+        void write(const char *data, size_t length, size_t lines = 1);
+        void flush(void);
+        void setRotationPolicy(const RotationPolicy &policy);
+
+        /**
+         * @brief writePending  Crash path. Write the buffered lines straight to fd with write(2),
+         *                      skipped if another thread is changing the buffer. Async-signal-safe.
+         */
+        void writePending(int fd);
+
+        size_t queueDepth(void) const;
+        quint64 bytesWritten(void) const;
+        uint64_t rotationCount(void) const;
+
+    private:
+        QString file_name_;
+        size_t flush_bytes_;
+        std::chrono::milliseconds flush_interval_;
+
+        std::mutex mtx_;
+        std::condition_variable cond_;
+        std::string pending_;
+        std::atomic<bool> pending_busy_;    // Held while pending_ changes, all the crash path can test
+        size_t pending_lines_ = 0;
+        bool flush_requested_ = false;
+        bool running_ = true;
+        RotationPolicy policy_;
+
+        std::atomic<size_t> queue_depth_;
+        std::atomic<quint64> bytes_written_;
+        std::atomic<uint64_t> rotations_;
+
+        LogCompressor compressor_;
+
+        std::thread *writer_thread_ = NULL;
+
+        void lockPending(void);
+        void unlockPending(void);
+        void run();
+        bool open(QFile &file, qint64 &size, QDate &day);
+        void rotate(QFile &file, const QDate &day);
+};
+
+#endif // LOGWRITER_H
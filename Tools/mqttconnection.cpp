@@ -0,0 +1,641 @@
+#include "mqttconnection.h"
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    const int PROBE_TIMEOUT_MS = 1000;
+    const char DEFAULT_PORT[] = "1883";
+}
+
+void MqttConnection::Listener::on_success(const mqtt::token &tok)
+{
+    Q_UNUSED(tok);
+    owner_->onSuccess(action_);
+}
+
+void MqttConnection::Listener::on_failure(const mqtt::token &tok)
+{
+    owner_->onFailure(action_, "return code " + std::to_string(tok.get_return_code()));
+}
+
+MqttConnection::MqttConnection(mqtt::async_client *client, const mqtt::connect_options &options, Console *console) :
+    connect_listener_(this, Action::Connect),
+    subscribe_listener_(this, Action::Subscribe),
+    random_(std::random_device()())
+{
+    cli_ = client;
+    options_ = options;
+    // Reconnection is driven by this class, not by paho
+    options_.set_automatic_reconnect(false);
+    console_ = console;
+    ready_ = false;
+    attempts_ = 0;
+    reconnects_ = 0;
+    failovers_ = 0;
+    probing_ = false;
+    switch_back_interval_ = std::chrono::milliseconds(0);
+
+    cli_->set_connection_lost_handler([this](const std::string &cause) {
+        onConnectionLost(cause);
+    });
+    // MQTT v5 DISCONNECT sent by the broker, with its reason
+    cli_->set_disconnected_handler([this](const mqtt::properties &properties, mqtt::ReasonCode reason) {
+        Q_UNUSED(properties);
+        onDisconnected(reason);
+    });
+
+    manager_thread_ = new std::thread(&MqttConnection::run, this);
+}
+
+MqttConnection::~MqttConnection()
+{
+    stop();
+    joinThreads();
+}
+
+void MqttConnection::addSubscription(const std::string &topic, int qos)
+{
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        topics_.push_back(topic);
+        qos_.push_back(qos);
+        ready = (state_ == State::Ready);
+    }
+    if (!ready)
+    {
+        return;
+    }
+    try {
+        // A failure shows up as a missing subscription, restored with the next connect
+        cli_->subscribe(topic, qos);
+    }
+    catch (const mqtt::exception& exc) {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt subscription to %s failed: %s", topic.c_str(), exc.what());
+    }
+}
+
+void MqttConnection::removeSubscription(const std::string &topic)
+{
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = std::find(topics_.begin(), topics_.end(), topic);
+        if (it == topics_.end())
+        {
+            return;
+        }
+        qos_.erase(qos_.begin() + (it - topics_.begin()));
+        topics_.erase(it);
+        ready = (state_ == State::Ready);
+    }
+    if (!ready)
+    {
+        return;
+    }
+    try {
+        cli_->unsubscribe(topic);
+    }
+    catch (const mqtt::exception& exc) {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt unsubscribe from %s failed: %s", topic.c_str(), exc.what());
+    }
+}
+
+void MqttConnection::setConsole(Console *console)
+{
+    console_ = console;
+}
+
+void MqttConnection::setBackoffPolicy(const BackoffPolicy &policy)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    policy_ = policy;
+}
+
+void MqttConnection::setOptions(const mqtt::connect_options &options)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    options_ = options;
+    options_.set_automatic_reconnect(false);
+}
+
+void MqttConnection::setServers(const std::vector<std::string> &servers, int switch_back_interval_ms)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    servers_ = servers;
+    server_index_ = 0;
+    switch_back_interval_ = std::chrono::milliseconds(switch_back_interval_ms);
+}
+
+void MqttConnection::start()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (state_ != State::Disconnected)
+        {
+            return;
+        }
+        pending_action_ = Action::Connect;
+        due_ = std::chrono::steady_clock::now();
+    }
+    cond_.notify_one();
+}
+
+void MqttConnection::stop(int timeout_ms)
+{
+    bool was_connected = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        pending_action_ = Action::None;
+        was_connected = (state_ == State::Subscribing || state_ == State::Ready);
+        state_ = State::Stopped;
+    }
+    cond_.notify_one();
+
+    if (ready_.exchange(false))
+    {
+        emit readyChanged(false);
+    }
+    emit stateChanged(static_cast<int>(State::Stopped));
+
+    if (was_connected || cli_->is_connected())
+    {
+        try {
+            cli_->disconnect()->wait_for(std::chrono::milliseconds(timeout_ms));
+        }
+        catch (const mqtt::exception& exc) {
+            CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s", exc.what());
+        }
+    }
+
+    // Neither thread touches the client once this returns, it may be deleted
+    joinThreads();
+}
+
+void MqttConnection::joinThreads()
+{
+    // The manager thread starts probes, once it is gone no new one appears
+    if (manager_thread_ != NULL && manager_thread_->get_id() != std::this_thread::get_id())
+    {
+        manager_thread_->join();
+        delete manager_thread_;
+        manager_thread_ = NULL;
+    }
+    if (probe_thread_ != NULL && probe_thread_->get_id() != std::this_thread::get_id())
+    {
+        probe_thread_->join();
+        delete probe_thread_;
+        probe_thread_ = NULL;
+    }
+}
+
+void MqttConnection::checkConnection()
+{
+    bool lost = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        lost = (state_ == State::Ready && !cli_->is_connected());
+    }
+    if (lost)
+    {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "WiFi Network Reconnection Detected. Attempting MQTT reconnection!");
+        onConnectionLost("connection check");
+    }
+}
+
+void MqttConnection::linkLost(const std::string &cause)
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_ || state_ != State::Ready)
+        {
+            return;
+        }
+    }
+    try {
+        // No wait, the reconnect attempt fails and backs off if this has not completed yet
+        cli_->disconnect(0);
+    }
+    catch (const mqtt::exception& exc) {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s", exc.what());
+    }
+    onConnectionLost(cause, true);
+}
+
+MqttConnection::State MqttConnection::state() const
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return state_;
+}
+
+bool MqttConnection::isReady() const
+{
+    return ready_;
+}
+
+uint64_t MqttConnection::attemptCount() const
+{
+    return attempts_;
+}
+
+uint64_t MqttConnection::reconnectCount() const
+{
+    return reconnects_;
+}
+
+uint64_t MqttConnection::failoverCount() const
+{
+    return failovers_;
+}
+
+std::string MqttConnection::currentServer() const
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return servers_.empty()? cli_->get_server_uri() : servers_[server_index_];
+}
+
+const char *MqttConnection::stateName(State state)
+{
+    switch (state)
+    {
+        case State::Disconnected: return "disconnected";
+        case State::Connecting: return "connecting";
+        case State::Subscribing: return "subscribing";
+        case State::Ready: return "ready";
+        case State::Backoff: return "backoff";
+        default: return "stopped";
+    }
+}
+
+void MqttConnection::run()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (running_)
+    {
+        if (pending_action_ == Action::None && state_ == State::Ready && onFallback())
+        {
+            if (std::chrono::steady_clock::now() < probe_due_)
+            {
+                cond_.wait_until(lck, probe_due_);
+                continue;
+            }
+            probe_due_ = std::chrono::steady_clock::now() + switch_back_interval_;
+            if (probing_)
+            {
+                // Name resolution of the previous probe still pending
+                continue;
+            }
+
+            // Name resolution may block for seconds, this thread keeps serving the state machine
+            if (probe_thread_ != NULL)
+            {
+                probe_thread_->join();
+                delete probe_thread_;
+            }
+            probing_ = true;
+            probe_thread_ = new std::thread(&MqttConnection::probe, this, servers_.front());
+            continue;
+        }
+        if (pending_action_ == Action::None)
+        {
+            cond_.wait(lck);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < due_)
+        {
+            cond_.wait_until(lck, due_);
+            continue;
+        }
+
+        Action action = pending_action_;
+        pending_action_ = Action::None;
+        State state = (action == Action::Connect)? State::Connecting : State::Subscribing;
+        setState(state);
+
+        // paho calls return immediately, the result arrives on a listener
+        lck.unlock();
+        emit stateChanged(static_cast<int>(state));
+        execute(action);
+        lck.lock();
+    }
+}
+
+void MqttConnection::execute(Action action)
+{
+    try {
+        if (action == Action::Connect)
+        {
+            mqtt::connect_options options;
+            {
+                std::lock_guard<std::mutex> lck(mtx_);
+                options = options_;
+                if (!servers_.empty())
+                {
+                    options.set_servers(mqtt::string_collection::create({servers_[server_index_]}));
+                }
+            }
+            attempts_++;
+            cli_->connect(options, NULL, connect_listener_);
+        }
+        else
+        {
+            std::vector<std::string> topics;
+            std::vector<int> qos;
+            {
+                std::lock_guard<std::mutex> lck(mtx_);
+                topics = topics_;
+                qos = qos_;
+            }
+            if (topics.empty())
+            {
+                onSuccess(Action::Subscribe);
+                return;
+            }
+            cli_->subscribe(mqtt::string_collection::create(topics), qos, NULL, subscribe_listener_);
+        }
+    }
+    catch (const mqtt::exception& exc) {
+        onFailure(action, exc.what());
+    }
+}
+
+void MqttConnection::onSuccess(Action action)
+{
+    State state;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_)
+        {
+            return;
+        }
+        if (action == Action::Connect)
+        {
+            pending_action_ = Action::Subscribe;
+            due_ = std::chrono::steady_clock::now();
+            probe_due_ = due_ + switch_back_interval_;
+            state = State::Subscribing;
+        }
+        else
+        {
+            failures_ = 0;
+            state = State::Ready;
+        }
+        setState(state);
+    }
+    cond_.notify_one();
+    emit stateChanged(static_cast<int>(state));
+
+    if (action == Action::Connect)
+    {
+        CONSOLE_INFO(console_, LogTag::Mqtt, "Connected to Mqtt Server: %s. Client: %s",
+                     currentServer().c_str(), cli_->get_client_id().c_str());
+    }
+    else
+    {
+        CONSOLE_INFO(console_, LogTag::Mqtt, "Mqtt connection ready (subscriptions active)");
+        if (!ready_.exchange(true))
+        {
+            emit readyChanged(true);
+        }
+    }
+}
+
+void MqttConnection::onFailure(Action action, const std::string &reason)
+{
+    int delay_ms = 0;
+    std::string next_server;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_)
+        {
+            return;
+        }
+        if (action == Action::Subscribe && cli_->is_connected())
+        {
+            // A failed subscribe on a live connection is retried as a subscribe
+            scheduleRetry(Action::Subscribe);
+        }
+        else if (servers_.size() > 1 && server_index_ + 1 < servers_.size())
+        {
+            // Next broker right away, backoff once all of them failed
+            server_index_++;
+            failovers_++;
+            next_server = servers_[server_index_];
+            pending_action_ = Action::Connect;
+            due_ = std::chrono::steady_clock::now();
+            setState(State::Backoff);
+        }
+        else
+        {
+            server_index_ = 0;
+            scheduleRetry(Action::Connect);
+        }
+        delay_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        due_ - std::chrono::steady_clock::now()).count());
+    }
+    cond_.notify_one();
+    emit stateChanged(static_cast<int>(State::Backoff));
+
+    if (!next_server.empty())
+    {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt %s failed (%s). Failing over to %s",
+                      (action == Action::Connect)? "connection" : "subscription", reason.c_str(), next_server.c_str());
+        return;
+    }
+    CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt %s failed (%s). Retrying in %d ms",
+                  (action == Action::Connect)? "connection" : "subscription", reason.c_str(), std::max(delay_ms, 0));
+}
+
+void MqttConnection::switchBack()
+{
+    std::string primary, fallback;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_ || state_ != State::Ready || !onFallback())
+        {
+            return;
+        }
+        primary = servers_.front();
+        fallback = servers_[server_index_];
+        server_index_ = 0;
+    }
+    CONSOLE_INFO(console_, LogTag::Mqtt, "Primary Mqtt server %s reachable again, leaving %s",
+                 primary.c_str(), fallback.c_str());
+    try {
+        cli_->disconnect(0);
+    }
+    catch (const mqtt::exception& exc) {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s", exc.what());
+    }
+    onConnectionLost("switching back to primary server");
+}
+
+void MqttConnection::probe(std::string primary)
+{
+    if (probeServer(primary, PROBE_TIMEOUT_MS))
+    {
+        switchBack();
+    }
+    probing_ = false;
+}
+
+void MqttConnection::onDisconnected(mqtt::ReasonCode reason)
+{
+    if (reason != mqtt::ReasonCode::SESSION_TAKEN_OVER)
+    {
+        onConnectionLost("disconnected by the broker, reason code " + std::to_string(static_cast<int>(reason)));
+        return;
+    }
+
+    // Another client connected with our id. Reconnecting would take the session back and get
+    // that one disconnected in turn, both would keep kicking each other off.
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_)
+        {
+            return;
+        }
+        taken_over_ = true;
+        pending_action_ = Action::None;
+        setState(State::Disconnected);
+    }
+    if (ready_.exchange(false))
+    {
+        emit readyChanged(false);
+    }
+    emit stateChanged(static_cast<int>(State::Disconnected));
+    CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt session taken over by another client with id %s, not reconnecting. "
+                  "Give each instance its own mqtt.instance_id", cli_->get_client_id().c_str());
+}
+
+void MqttConnection::onConnectionLost(const std::string &cause, bool fail_over)
+{
+    std::string next_server;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (!running_ || taken_over_ || state_ == State::Backoff || state_ == State::Connecting)
+        {
+            return;
+        }
+        if (fail_over && servers_.size() > 1)
+        {
+            // The broker accepted us but does not carry traffic, the next one may
+            server_index_ = (server_index_ + 1) % servers_.size();
+            failovers_++;
+            next_server = servers_[server_index_];
+        }
+        // First attempt right away, backoff applies to the following ones
+        failures_ = 0;
+        pending_action_ = Action::Connect;
+        due_ = std::chrono::steady_clock::now();
+        setState(State::Backoff);
+    }
+    reconnects_++;
+    cond_.notify_one();
+
+    if (ready_.exchange(false))
+    {
+        emit readyChanged(false);
+    }
+    emit stateChanged(static_cast<int>(State::Backoff));
+    if (!next_server.empty())
+    {
+        CONSOLE_WARN(console_, LogTag::Mqtt, "Mqtt disconnected (%s). Failing over to %s", cause.c_str(), next_server.c_str());
+        return;
+    }
+    CONSOLE_WARN(console_, LogTag::Mqtt, "Mqtt disconnected (%s). Reconnecting now...", cause.c_str());
+}
+
+void MqttConnection::setState(State state)
+{
+    state_ = state;
+}
+
+bool MqttConnection::onFallback() const
+{
+    return server_index_ > 0 && switch_back_interval_.count() > 0;
+}
+
+bool MqttConnection::probeServer(const std::string &uri, int timeout_ms)
+{
+    // [scheme://]host[:port]
+    std::string address = uri;
+    size_t scheme = address.find("://");
+    if (scheme != std::string::npos)
+    {
+        address = address.substr(scheme + 3);
+    }
+    std::string host = address;
+    std::string port = DEFAULT_PORT;
+    size_t colon = address.rfind(':');
+    if (colon != std::string::npos)
+    {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+    {
+        return false;
+    }
+
+    bool reachable = false;
+    for (addrinfo *ai = result; ai != NULL && !reachable; ai = ai->ai_next)
+    {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            reachable = true;
+        }
+        else if (errno == EINPROGRESS)
+        {
+            pollfd pfd = {fd, POLLOUT, 0};
+            int error = 0;
+            socklen_t length = sizeof(error);
+            reachable = poll(&pfd, 1, timeout_ms) == 1
+                        && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+        }
+        close(fd);
+    }
+    freeaddrinfo(result);
+    return reachable;
+}
+
+void MqttConnection::scheduleRetry(Action action)
+{
+    double delay = policy_.initial_ms * std::pow(policy_.multiplier, failures_);
+    delay = std::min(delay, static_cast<double>(policy_.max_ms));
+    std::uniform_real_distribution<double> jitter(1.0 - policy_.jitter, 1.0 + policy_.jitter);
+    delay *= jitter(random_);
+
+    // Stop growing once the cap is reached
+    if (policy_.initial_ms * std::pow(policy_.multiplier, failures_) < policy_.max_ms)
+    {
+        failures_++;
+    }
+    pending_action_ = action;
+    due_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(delay));
+    setState(State::Backoff);
+}
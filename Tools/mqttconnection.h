@@ -0,0 +1,193 @@
+#ifndef MQTTCONNECTION_H
+#define MQTTCONNECTION_H
+
+#include <QObject>
+#include <mqtt/async_client.h>
+#include <Tools/console.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The MqttConnection class
+ * Asynchronous connect / subscribe / reconnect state machine around a paho async_client.
+ * Connection and subscription results arrive through action listeners, retries are scheduled
+ * with exponential backoff and jitter on a dedicated manager thread. No public call waits on
+ * the network (except stop, bounded), so it is safe to drive from the GUI thread.
+ * With several brokers configured, a failed connect moves on to the next one immediately and
+ * backoff only applies once every broker has failed. A link found dead by the heartbeat moves on
+ * to the next broker as well. While on a fallback broker the primary is probed periodically, on a
+ * thread of its own, and the link switches back as soon as it accepts connections again.
+ * A session taken over by another client with the same id is reported and not reconnected.
+ */
+class MqttConnection : public QObject
+{
+    Q_OBJECT
+
+    public:
+        enum class State {
+            Disconnected,   // Not started
+            Connecting,     // CONNECT in flight
+            Subscribing,    // Connected, SUBSCRIBE in flight
+            Ready,          // Connected and subscribed
+            Backoff,        // Waiting for the next attempt
+            Stopped
+        };
+
+        struct BackoffPolicy
+        {
+            int initial_ms = 500;
+            int max_ms = 30000;
+            double multiplier = 2.0;
+            double jitter = 0.2;        // Each delay is scaled by a random factor in [1 - jitter, 1 + jitter]
+        };
+
+        MqttConnection(mqtt::async_client *client, const mqtt::connect_options &options, Console *console);
+        ~MqttConnection();
+
+        /**
+         * @brief addSubscription   Topic (re)subscribed after every successful connect, and
+         *                          right away if the connection is ready
+         */
+        void addSubscription(const std::string &topic, int qos);
+
+        /**
+         * @brief removeSubscription    No longer subscribed after reconnects, unsubscribed right
+         *                              away if the connection is ready
+         */
+        void removeSubscription(const std::string &topic);
+        void setConsole(Console *console);
+        void setBackoffPolicy(const BackoffPolicy &policy);
+
+        /**
+         * @brief setOptions    Connect options (keep-alive, will), used from the next attempt on
+         */
+        void setOptions(const mqtt::connect_options &options);
+
+        /**
+         * @brief setServers    Broker URIs in order of preference, the first one is the primary
+         * @param switch_back_interval_ms   Primary probe period while on a fallback broker, 0 never switches back
+         */
+        void setServers(const std::vector<std::string> &servers, int switch_back_interval_ms);
+
+        /**
+         * @brief start     Begin connecting. Returns immediately.
+         */
+        void start(void);
+
+        /**
+         * @brief stop      Cancel pending attempts and disconnect, waits at most timeout_ms for
+         *                  the disconnect. Returns once the manager and probe threads have
+         *                  finished (a probe may take a name resolution timeout), so the
+         *                  client can be deleted afterwards.
+         */
+        void stop(int timeout_ms = 1000);
+
+        /**
+         * @brief checkConnection   Non-blocking liveness check, schedules a reconnect if the
+         *                          link dropped without a connection lost callback
+         */
+        void checkConnection(void);
+
+        /**
+         * @brief linkLost      The link is known to be dead although paho still reports it
+         *                      connected (half-open TCP, missed heartbeats). Drops and reconnects
+         *                      to the next broker, if there are several.
+         */
+        void linkLost(const std::string &cause);
+
+        State state(void) const;
+        bool isReady(void) const;
+        uint64_t attemptCount(void) const;
+        uint64_t reconnectCount(void) const;
+        uint64_t failoverCount(void) const;
+        std::string currentServer(void) const;
+
+        static const char *stateName(State state);
+
+    signals:
+        void stateChanged(int state);
+        void readyChanged(bool ready);
+
+    private:
+        enum class Action {
+            None,
+            Connect,
+            Subscribe
+        };
+
+        /**
+         * Routes paho action results back to the owning state machine
+         */
+        class Listener : public mqtt::iaction_listener
+        {
+            public:
+                Listener(MqttConnection *owner, Action action) : owner_(owner), action_(action) {}
+                void on_success(const mqtt::token &tok) override;
+                void on_failure(const mqtt::token &tok) override;
+
+            private:
+                MqttConnection *owner_;
+                Action action_;
+        };
+
+        mqtt::async_client *cli_;
+        mqtt::connect_options options_;
+        Console *console_;
+
+        std::vector<std::string> topics_;
+        std::vector<int> qos_;
+        BackoffPolicy policy_;
+        std::vector<std::string> servers_;
+        size_t server_index_ = 0;
+        std::chrono::milliseconds switch_back_interval_;
+        std::chrono::steady_clock::time_point probe_due_;
+
+        mutable std::mutex mtx_;
+        std::condition_variable cond_;
+        State state_ = State::Disconnected;
+        Action pending_action_ = Action::None;
+        std::chrono::steady_clock::time_point due_;
+        int failures_ = 0;
+        bool running_ = true;
+        bool taken_over_ = false;       // Another client uses our id, see onDisconnected
+
+        std::atomic<bool> ready_;
+        std::atomic<uint64_t> attempts_;
+        std::atomic<uint64_t> reconnects_;
+        std::atomic<uint64_t> failovers_;
+
+        Listener connect_listener_;
+        Listener subscribe_listener_;
+        std::mt19937 random_;
+        std::thread *manager_thread_ = NULL;
+        std::thread *probe_thread_ = NULL;
+        std::atomic<bool> probing_;
+
+        void run(void);
+        void execute(Action action);
+        void onSuccess(Action action);
+        void onFailure(Action action, const std::string &reason);
+        void onConnectionLost(const std::string &cause, bool fail_over = false);
+        void onDisconnected(mqtt::ReasonCode reason);
+        void switchBack(void);
+        void probe(std::string primary);
+        void joinThreads(void);
+
+        // Called with mtx_ held
+        void setState(State state);
+        void scheduleRetry(Action action);
+        bool onFallback(void) const;
+
+        /**
+         * @brief probeServer   TCP connect to the broker of uri within timeout_ms
+         */
+        static bool probeServer(const std::string &uri, int timeout_ms);
+};
+
+#endif // MQTTCONNECTION_H
@@ -0,0 +1,123 @@
+#include "mqttlogsink.h"
+#include "robotCommunication.h"
+#include <algorithm>
+
+MqttLogSink::MqttLogSink(RobotCommunication *com, std::string topic, double rate, int burst, int coalesce_ms) :
+    LogSink(LogLevel::Warning)
+{
+    com_ = com;
+    topic_ = topic;
+    rate_ = rate;
+    burst_ = burst;
+    coalesce_window_ = std::chrono::milliseconds(coalesce_ms);
+    tokens_ = burst_;
+    last_refill_ = std::chrono::steady_clock::now();
+    last_published_ = last_refill_;
+    published_ = 0;
+    suppressed_ = 0;
+}
+
+void MqttLogSink::write(const LogRecord &rec)
+{
+    if (rec.tag == LogTag::Mqtt)
+    {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (last_text_.size() == rec.length && last_text_.compare(0, rec.length, rec.text, rec.length) == 0 &&
+            now - last_published_ < coalesce_window_)
+    {
+        // Identical to the last published message, reported as a repeat count later
+        repeats_++;
+        suppressed_++;
+        return;
+    }
+
+    // Close the previous run of repeats before moving on
+    if (repeats_ > 0)
+    {
+        if (takeToken(now))
+        {
+            publish(last_record_, repeats_);
+        }
+        else
+        {
+            rate_limited_ += repeats_;
+        }
+        repeats_ = 0;
+    }
+
+    if (!takeToken(now))
+    {
+        rate_limited_++;
+        suppressed_++;
+        return;
+    }
+
+    last_text_.assign(rec.text, rec.length);
+    last_record_ = rec;
+    last_published_ = now;
+    publish(rec, 0);
+}
+
+void MqttLogSink::flush()
+{
+    if (repeats_ == 0)
+    {
+        return;
+    }
+
+    // Report pending repeats once the coalescing window has passed
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_published_ >= coalesce_window_ && takeToken(now))
+    {
+        publish(last_record_, repeats_);
+        repeats_ = 0;
+        last_text_.clear();
+    }
+}
+
+bool MqttLogSink::takeToken(std::chrono::steady_clock::time_point now)
+{
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    last_refill_ = now;
+    if (tokens_ < 1.0)
+    {
+        return false;
+    }
+    tokens_ -= 1.0;
+    return true;
+}
+
+void MqttLogSink::publish(const LogRecord &rec, uint32_t repeats)
+{
+    Json::Value message_json;
+    Json::FastWriter writer;
+    message_json["level"] = logLevelName(rec.level);
+    message_json["tag"] = logTagName(rec.tag);
+    message_json["message"] = std::string(rec.text, rec.length);
+    message_json["timestamp"] = static_cast<Json::Int64>(rec.timestamp_ms);
+    if (repeats > 0)
+    {
+        message_json["repeated"] = repeats;
+    }
+    if (rate_limited_ > 0)
+    {
+        message_json["suppressed"] = rate_limited_;
+        rate_limited_ = 0;
+    }
+    com_->publish(topic_, writer.write(message_json));
+    published_++;
+}
+
+uint64_t MqttLogSink::publishedCount() const
+{
+    return published_;
+}
+
+uint64_t MqttLogSink::suppressedCount() const
+{
+    return suppressed_;
+}
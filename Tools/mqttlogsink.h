@@ -0,0 +1,60 @@
+#ifndef MQTTLOGSINK_H
+#define MQTTLOGSINK_H
+
+#include <string>
+#include <chrono>
+#include "logsink.h"
+
+class RobotCommunication;
+
+/**
+ * @brief The MqttLogSink class
+ * Publishes warnings and errors to an MQTT topic for central monitoring. Repeats of the same
+ * message are coalesced into one publish carrying a repeat count, and a token bucket limits
+ * the publish rate. Records tagged mqtt are ignored, so a failing publish cannot feed itself.
+ */
+class MqttLogSink : public LogSink
+{
+    public:
+        /**
+         * @brief MqttLogSink
+         * @param com           Communicator used to publish
+         * @param topic         Destination topic
+         * @param rate          Sustained publishes per second
+         * @param burst         Token bucket size
+         * @param coalesce_ms   Window in which identical messages are merged
+         */
+        MqttLogSink(RobotCommunication *com, std::string topic = "robot_log", double rate = 1.0,
+                    int burst = 5, int coalesce_ms = 5000);
+
+        void write(const LogRecord &rec) Q_DECL_OVERRIDE;
+        void flush(void) Q_DECL_OVERRIDE;
+
+        uint64_t publishedCount(void) const;
+        uint64_t suppressedCount(void) const;
+
+    private:
+        RobotCommunication *com_;
+        std::string topic_;
+        double rate_;
+        double burst_;
+        std::chrono::milliseconds coalesce_window_;
+
+        double tokens_;
+        std::chrono::steady_clock::time_point last_refill_;
+
+        // Last published message, for coalescing
+        std::string last_text_;
+        LogRecord last_record_;
+        std::chrono::steady_clock::time_point last_published_;
+        uint32_t repeats_ = 0;
+
+        uint32_t rate_limited_ = 0;     // Dropped since the last publish
+        std::atomic<uint64_t> published_;
+        std::atomic<uint64_t> suppressed_;
+
+        bool takeToken(std::chrono::steady_clock::time_point now);
+        void publish(const LogRecord &rec, uint32_t repeats);
+};
+
+#endif // MQTTLOGSINK_H
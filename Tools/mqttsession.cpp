@@ -0,0 +1,660 @@
+#include "mqttsession.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace
+{
+    const char PRESENCE_ONLINE[] = "{\"status\":\"online\"}";
+    const char PRESENCE_OFFLINE[] = "{\"status\":\"offline\"}";
+
+    // FNV-1a, names the instance owning a journal file in its client id
+    uint32_t hashPath(const std::string &path)
+    {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : path)
+        {
+            hash ^= c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+void MqttSession::DeliveryListener::on_success(const mqtt::token &tok)
+{
+    owner_->onDelivery(reinterpret_cast<uintptr_t>(tok.get_user_context()), true, 0);
+}
+
+void MqttSession::DeliveryListener::on_failure(const mqtt::token &tok)
+{
+    owner_->onDelivery(reinterpret_cast<uintptr_t>(tok.get_user_context()), false, tok.get_return_code());
+}
+
+std::shared_ptr<MqttSession> MqttSession::shared(Console *console)
+{
+    static std::mutex mtx;
+    static std::weak_ptr<MqttSession> instance;
+
+    std::lock_guard<std::mutex> lck(mtx);
+    std::shared_ptr<MqttSession> session = instance.lock();
+    if (!session)
+    {
+        session.reset(new MqttSession(console));
+        instance = session;
+    }
+    session->join(console);
+    return session;
+}
+
+MqttSession::MqttSession(Console *console) :
+    delivery_listener_(this)
+{
+    console_ = console;
+    unrouted_ = 0;
+
+    /// Initialize Connection status checker
+    timer_ = new QTimer(this);
+    connect(timer_, &QTimer::timeout, this, &MqttSession::check_status);
+    heartbeat_timer_ = new QTimer(this);
+    connect(heartbeat_timer_, &QTimer::timeout, this, &MqttSession::sendHeartbeat);
+}
+
+MqttSession::~MqttSession()
+{
+    heartbeat_timer_->stop();
+    if (connection_ != NULL)
+    {
+        // Robot contexts published their wills already. A clean disconnect does not trigger
+        // the session's will either, publish it ourselves.
+        enqueue(presence_topic_, std::make_shared<const std::string>(PRESENCE_OFFLINE), true);
+        try {
+            cli->stop_consuming();
+        }
+        catch (const mqtt::exception& exc) {
+            CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s", exc.what());
+        }
+        // Joins the connection threads, none of them uses the client past this point
+        connection_->stop();
+    }
+    // Client next, so no listener fires into a deleted connection
+    delete cli;
+    delete connection_;
+    delete journal_;
+}
+
+void MqttSession::join(Console *console)
+{
+    if (std::find(consoles_.begin(), consoles_.end(), console) == consoles_.end())
+    {
+        consoles_.push_back(console);
+    }
+}
+
+void MqttSession::leave(Console *console)
+{
+    consoles_.erase(std::remove(consoles_.begin(), consoles_.end(), console), consoles_.end());
+    if (console_ == console && !consoles_.empty())
+    {
+        // The session outlives the robot that created it
+        console_ = consoles_.front();
+        if (connection_ != NULL)
+        {
+            connection_->setConsole(console_);
+        }
+    }
+}
+
+void MqttSession::setServerOptions(const ServerOptions &options)
+{
+    if (started())
+    {
+        CONSOLE_INFO(console_, LogTag::Mqtt, "Mqtt session already started, server options of %s kept", client_id_.c_str());
+        return;
+    }
+    server_options_ = options;
+    if (server_options_.servers.empty())
+    {
+        server_options_.servers = ServerOptions().servers;
+    }
+}
+
+void MqttSession::setLinkOptions(const LinkOptions &options)
+{
+    if (started())
+    {
+        return;
+    }
+    link_options_ = options;
+}
+
+const std::string &MqttSession::presenceTopic() const
+{
+    return presence_topic_;
+}
+
+void MqttSession::start()
+{
+    if (cli != NULL)
+    {
+        return;
+    }
+    bool journal_owned = openJournal();
+
+    // Same id on every restart, so the session the broker kept for us is resumed, but never
+    // the id of another instance: it would take over our session and our queued commands
+    client_id_ = server_options_.client_id;
+    if (server_options_.unique_client_id)
+    {
+        char host[64] = "";
+        gethostname(host, sizeof(host) - 1);
+        client_id_ += "-" + std::string(host);
+        if (!server_options_.instance_id.empty())
+        {
+            client_id_ += "-" + server_options_.instance_id;
+        }
+        else if (!journal_owned)
+        {
+            // The instance holding the journal uses its id, this one gets a session of its own
+            client_id_ += "-" + std::to_string(getpid());
+            CONSOLE_WARN(console_, LogTag::Mqtt, "Mqtt journal held by another instance, set mqtt.instance_id. "
+                         "Client id %s is not kept across restarts", client_id_.c_str());
+        }
+        else if (journal_ != NULL)
+        {
+            char suffix[16];
+            snprintf(suffix, sizeof(suffix), "-%08x", hashPath(link_options_.journal_file));
+            client_id_ += suffix;
+        }
+    }
+
+    // MQTT Client, connected asynchronously. Readiness is reported through readyChanged
+    cli = new mqtt::async_client(server_options_.servers.front(), client_id_, mqtt::create_options(MQTTVERSION_5));
+    connect_client();
+    connection_->setServers(server_options_.servers, server_options_.switch_back_interval_ms);
+
+    connOpts.set_keep_alive_interval(link_options_.keep_alive_s);
+    connOpts.set_max_inflight(link_options_.inflight_window);
+    delivery_.setWindow(link_options_.inflight_window);
+    delivery_.setTimeout(link_options_.ack_timeout_ms);
+    delivery_.setMaxRetries(link_options_.max_retries);
+    // Commands published while we are offline stay queued on the broker, until they expire
+    mqtt::properties properties;
+    properties.add(mqtt::property(mqtt::property::SESSION_EXPIRY_INTERVAL, static_cast<uint32_t>(link_options_.session_expiry_s)));
+    connOpts.set_properties(properties);
+    // One will for the whole connection, robots name this topic on their own presence topic
+    presence_topic_ = link_options_.presence_topic + "/" + client_id_;
+    connOpts.set_will(mqtt::will_options(presence_topic_, PRESENCE_OFFLINE, QOS, true));
+    connection_->setOptions(connOpts);
+
+    if (link_options_.heartbeat_interval_ms > 0)
+    {
+        // Per client topic, so only our own pings are echoed back
+        heartbeat_topic_ = link_options_.heartbeat_topic + "/" + client_id_;
+        heartbeat_.setTimeout(link_options_.heartbeat_timeout_ms);
+        connection_->addSubscription(heartbeat_topic_, 0);
+        heartbeat_timer_->start(link_options_.heartbeat_interval_ms);
+    }
+
+    connection_->start();
+    timer_->start(1000);
+}
+
+bool MqttSession::openJournal()
+{
+    if (link_options_.journal_file.empty())
+    {
+        return true;
+    }
+    journal_ = new OutboundJournal(link_options_.journal_sync_interval_ms);
+    std::vector<OutboundMessage> replay;
+    if (!journal_->open(link_options_.journal_file, replay))
+    {
+        int error = errno;
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Cannot open Mqtt journal %s (%s), mission results are not kept across restarts",
+                      link_options_.journal_file.c_str(), strerror(error));
+        delete journal_;
+        journal_ = NULL;
+        return error != EWOULDBLOCK;
+    }
+
+    // Ahead of anything published by this run
+    std::lock_guard<std::mutex> lck(publish_mtx_);
+    for (const auto &msg : replay)
+    {
+        outbound_.push(msg);
+    }
+    if (!replay.empty())
+    {
+        CONSOLE_WARN(console_, LogTag::Mqtt, "%zu Mqtt messages of a previous run never acknowledged, sent again",
+                     replay.size());
+    }
+    return true;
+}
+
+bool MqttSession::started() const
+{
+    return cli != NULL;
+}
+
+bool MqttSession::attach(const std::string &name_space, Receiver receiver)
+{
+    std::lock_guard<std::mutex> lck(contexts_mtx_);
+    if (contexts_.count(name_space) > 0)
+    {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt topic namespace '%s' already used by another robot", name_space.c_str());
+        return false;
+    }
+    contexts_[name_space] = receiver;
+    return true;
+}
+
+void MqttSession::detach(const std::string &name_space)
+{
+    std::lock_guard<std::mutex> lck(contexts_mtx_);
+    contexts_.erase(name_space);
+}
+
+void MqttSession::addSubscription(const std::string &topic, int qos)
+{
+    if (connection_ != NULL)
+    {
+        connection_->addSubscription(topic, qos);
+    }
+    else
+    {
+        subscriptions_.push_back(std::make_pair(topic, qos));
+    }
+}
+
+void MqttSession::removeSubscription(const std::string &topic)
+{
+    if (connection_ != NULL)
+    {
+        connection_->removeSubscription(topic);
+        return;
+    }
+    subscriptions_.erase(std::remove_if(subscriptions_.begin(), subscriptions_.end(),
+                                        [&topic](const std::pair<std::string, int> &subscription) {
+                                            return subscription.first == topic;
+                                        }),
+                         subscriptions_.end());
+}
+
+void MqttSession::route(mqtt::const_message_ptr msg)
+{
+    const std::string &topic = msg->get_topic();
+    if (topic == heartbeat_topic_)
+    {
+        heartbeat_.onEcho(msg->get_payload_str());
+        emit heartbeatUpdated();
+        return;
+    }
+
+    RequestContext request;
+    const mqtt::properties &props = msg->get_properties();
+    if (props.contains(mqtt::property::RESPONSE_TOPIC))
+    {
+        request.response_topic = mqtt::get<std::string>(props, mqtt::property::RESPONSE_TOPIC);
+    }
+    if (props.contains(mqtt::property::CORRELATION_DATA))
+    {
+        request.correlation_data = mqtt::get<mqtt::binary>(props, mqtt::property::CORRELATION_DATA);
+    }
+    if (props.contains(mqtt::property::MESSAGE_EXPIRY_INTERVAL))
+    {
+        // Remaining interval, the broker deducts the time the command spent queued
+        request.setExpiry(mqtt::get<uint32_t>(props, mqtt::property::MESSAGE_EXPIRY_INTERVAL));
+    }
+
+    // Held during the hand over, so a detached context never receives another message
+    std::lock_guard<std::mutex> lck(contexts_mtx_);
+    size_t level = topic.find('/');
+    if (level != std::string::npos)
+    {
+        auto context = contexts_.find(topic.substr(0, level));
+        if (context != contexts_.end())
+        {
+            context->second(topic.substr(level + 1), msg->get_payload_str(), request);
+            return;
+        }
+    }
+    auto context = contexts_.find(std::string());
+    if (context != contexts_.end())
+    {
+        context->second(topic, msg->get_payload_str(), request);
+        return;
+    }
+    unrouted_++;
+    CONSOLE_DEBUG(console_, LogTag::Mqtt, "Mqtt message on %s matches no robot namespace", topic.c_str());
+}
+
+void MqttSession::enqueue(const std::string &topic, const Payload &payload, bool retained, const std::string &correlation_data,
+                          bool durable, const char *content_type)
+{
+    OutboundMessage out;
+    out.topic = topic;
+    out.payload = payload;
+    out.qos = QOS;
+    out.retained = retained;
+    out.correlation_data = correlation_data;
+    out.content_type = content_type;
+    if (durable && journal_ != NULL)
+    {
+        // Page cache only, the journal syncs in batches
+        out.journal_id = journal_->append(out);
+    }
+
+    std::lock_guard<std::mutex> lck(publish_mtx_);
+    if (!isReady())
+    {
+        outbound_.push(out);
+        return;
+    }
+    if (!outbound_.empty())
+    {
+        // Buffered messages go first, so nothing overtakes them. Sent right away if the window
+        // allows, a buffer left by a failed send would otherwise wait for the next PUBACK.
+        outbound_.push(out);
+        drainOutbound();
+        return;
+    }
+    if (!delivery_.hasCapacity())
+    {
+        // Backpressure, sent once a PUBACK frees a slot
+        delivery_.deferred();
+        outbound_.push(out);
+        return;
+    }
+    if (!send(out))
+    {
+        outbound_.push(out);
+        // Hands a silently dropped link to the connection manager, never reconnects inline
+        connection_->checkConnection();
+    }
+}
+
+bool MqttSession::send(const OutboundMessage &msg)
+{
+    // Shares the payload buffer, no copy
+    auto payload = mqtt::make_message(msg.topic, mqtt::binary_ref(msg.payload), msg.qos, msg.retained);
+    if (!msg.correlation_data.empty() || msg.content_type != NULL)
+    {
+        mqtt::properties props;
+        if (!msg.correlation_data.empty())
+        {
+            props.add(mqtt::property(mqtt::property::CORRELATION_DATA, mqtt::binary(msg.correlation_data)));
+        }
+        if (msg.content_type != NULL)
+        {
+            // Consumers tell the JSON and CBOR topics apart without knowing the configuration
+            props.add(mqtt::property(mqtt::property::CONTENT_TYPE, std::string(msg.content_type)));
+        }
+        payload->set_properties(props);
+    }
+    if (msg.qos == 0)
+    {
+        try{
+            cli->publish(payload);
+            return true;
+        }
+        catch(const mqtt::exception& exc){
+            CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s. Message to %s buffered", exc.what(), msg.topic.c_str());
+            return false;
+        }
+    }
+
+    uint64_t seq = delivery_.begin(msg);
+    try{
+        cli->publish(payload, reinterpret_cast<void *>(static_cast<uintptr_t>(seq)), delivery_listener_);
+        return true;
+    }
+    catch(const mqtt::exception& exc){
+        delivery_.cancel(seq);
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt exception: %s. Message to %s buffered", exc.what(), msg.topic.c_str());
+        return false;
+    }
+}
+
+size_t MqttSession::drainOutbound()
+{
+    // Called with publish_mtx_ held
+    size_t sent = 0;
+    OutboundMessage msg;
+    while (isReady() && delivery_.hasCapacity() && outbound_.pop(msg))
+    {
+        if (!send(msg))
+        {
+            outbound_.pushFront(msg);
+            break;
+        }
+        sent++;
+    }
+    return sent;
+}
+
+void MqttSession::onDelivery(uint64_t seq, bool delivered, int reason)
+{
+    std::lock_guard<std::mutex> lck(publish_mtx_);
+    if (delivered)
+    {
+        // Late PUBACKs included, whatever the in-flight window made of the slot
+        OutboundMessage acked;
+        delivery_.complete(seq, acked);
+        if (acked.journal_id != 0 && journal_ != NULL)
+        {
+            journal_->acknowledge(acked.journal_id);
+        }
+    }
+    else
+    {
+        OutboundMessage retry;
+        if (delivery_.fail(seq, retry))
+        {
+            if (retry.failed_attempts <= link_options_.max_retries)
+            {
+                CONSOLE_WARN(console_, LogTag::Mqtt, "Mqtt delivery to %s failed (return code %d), retry %d",
+                             retry.topic.c_str(), reason, retry.failed_attempts);
+                outbound_.pushFront(retry);
+            }
+            else
+            {
+                // Durable, never given up: parked and retried once a second by check_status
+                if (retry.failed_attempts == link_options_.max_retries + 1)
+                {
+                    CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt delivery to %s failed (return code %d) %d times, journaled message kept for retry",
+                                  retry.topic.c_str(), reason, retry.failed_attempts);
+                }
+                parked_.push_back(retry);
+            }
+        }
+        else if (!retry.topic.empty())
+        {
+            CONSOLE_ERROR(console_, LogTag::Mqtt, "Mqtt delivery to %s failed (return code %d), dropped after %d attempts",
+                          retry.topic.c_str(), reason, retry.failed_attempts);
+        }
+    }
+    // A slot was freed, send what backpressure held back
+    drainOutbound();
+}
+
+void MqttSession::flushOutbound(bool ready)
+{
+    if (!ready)
+    {
+        return;
+    }
+
+    // Pings of the previous connection will never be echoed
+    heartbeat_.reset();
+    // Replaces the will the broker may have published while we were away
+    enqueue(presence_topic_, std::make_shared<const std::string>(PRESENCE_ONLINE), true);
+
+    std::lock_guard<std::mutex> lck(publish_mtx_);
+    size_t sent = drainOutbound();
+
+    if (sent > 0 || outbound_.droppedCount() > 0)
+    {
+        CONSOLE_INFO(console_, LogTag::Mqtt, "Mqtt: Sent %zu buffered messages (%zu left, %llu dropped, %llu coalesced while offline)",
+                     sent, outbound_.depth(), static_cast<unsigned long long>(outbound_.droppedCount()),
+                     static_cast<unsigned long long>(outbound_.coalescedCount()));
+    }
+}
+
+void MqttSession::addCoalescedTopic(const std::string &topic)
+{
+    outbound_.addCoalescedTopic(topic);
+}
+
+void MqttSession::setOutboundCapacity(size_t capacity)
+{
+    outbound_.setCapacity(capacity);
+}
+
+size_t MqttSession::outboundDepth()
+{
+    return outbound_.depth();
+}
+
+uint64_t MqttSession::outboundDroppedCount() const
+{
+    return outbound_.droppedCount();
+}
+
+uint64_t MqttSession::outboundCoalescedCount() const
+{
+    return outbound_.coalescedCount();
+}
+
+void MqttSession::sendHeartbeat()
+{
+    if (!connection_->isReady())
+    {
+        return;
+    }
+
+    int missed = heartbeat_.consecutiveMissed();
+    if (missed >= link_options_.heartbeat_max_missed)
+    {
+        CONSOLE_WARN(console_, LogTag::Mqtt, "%d Mqtt heartbeats missed, link considered dead", missed);
+        heartbeat_.reset();
+        connection_->linkLost("heartbeat timeout");
+        emit heartbeatUpdated();
+        return;
+    }
+
+    // QoS 0 and never buffered, a late ping is worthless
+    auto ping = mqtt::make_message(heartbeat_topic_, heartbeat_.ping(), 0, false);
+    try {
+        cli->publish(ping);
+    }
+    catch (const mqtt::exception& exc) {
+        CONSOLE_DEBUG(console_, LogTag::Mqtt, "Mqtt heartbeat not sent: %s", exc.what());
+    }
+    emit heartbeatUpdated();
+}
+
+Heartbeat::Stats MqttSession::heartbeatStats()
+{
+    return heartbeat_.stats();
+}
+
+DeliveryTracker::Stats MqttSession::deliveryStats()
+{
+    return delivery_.stats();
+}
+
+OutboundJournal::Stats MqttSession::journalStats()
+{
+    return (journal_ != NULL)? journal_->stats() : OutboundJournal::Stats();
+}
+
+size_t MqttSession::contextCount()
+{
+    std::lock_guard<std::mutex> lck(contexts_mtx_);
+    return contexts_.size();
+}
+
+uint64_t MqttSession::unroutedCount() const
+{
+    return unrouted_;
+}
+
+bool MqttSession::isReady() const
+{
+    return connection_ != NULL && connection_->isReady();
+}
+
+MqttConnection::State MqttSession::connectionState() const
+{
+    return (connection_ != NULL)? connection_->state() : MqttConnection::State::Disconnected;
+}
+
+std::string MqttSession::currentServer() const
+{
+    return (connection_ != NULL)? connection_->currentServer() : server_options_.servers.front();
+}
+
+const std::string &MqttSession::clientId() const
+{
+    return client_id_;
+}
+
+const MqttSession::ServerOptions &MqttSession::serverOptions() const
+{
+    return server_options_;
+}
+
+const MqttSession::LinkOptions &MqttSession::linkOptions() const
+{
+    return link_options_;
+}
+
+void MqttSession::connect_client()
+{
+    connOpts.set_mqtt_version(MQTTVERSION_5);
+    connOpts.set_keep_alive_interval(link_options_.keep_alive_s);
+    // Resume the session, see LinkOptions::session_expiry_s
+    connOpts.set_clean_start(false);
+    // Bounds a single attempt, the connection manager retries with backoff
+    connOpts.set_connect_timeout(5);
+
+    cli->set_message_callback([this](mqtt::const_message_ptr msg) {
+        route(msg);
+    });
+
+    connection_ = new MqttConnection(cli, connOpts, console_);
+    for (const auto &subscription : subscriptions_)
+    {
+        connection_->addSubscription(subscription.first, subscription.second);
+    }
+    subscriptions_.clear();
+    connect(connection_, &MqttConnection::readyChanged, this, &MqttSession::flushOutbound);
+    connect(connection_, &MqttConnection::readyChanged, this, &MqttSession::readyChanged);
+}
+
+void MqttSession::check_status(void)
+{
+    // Non-blocking, a dropped link is handed back to the connection manager
+    connection_->checkConnection();
+
+    size_t expired = delivery_.expire();
+    if (expired > 0)
+    {
+        CONSOLE_WARN(console_, LogTag::Mqtt, "%zu Mqtt publishes not acknowledged within %d ms", expired, link_options_.ack_timeout_ms);
+    }
+
+    // Whatever left messages behind (failed send, expired slots), retried while the link is up
+    std::lock_guard<std::mutex> lck(publish_mtx_);
+    for (const OutboundMessage &msg : parked_)
+    {
+        outbound_.push(msg);
+    }
+    parked_.clear();
+    if (isReady() && !outbound_.empty())
+    {
+        drainOutbound();
+    }
+}
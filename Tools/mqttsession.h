@@ -0,0 +1,224 @@
+#ifndef MQTTSESSION_H
+#define MQTTSESSION_H
+
+#include <QObject>
+#include <mqtt/async_client.h>
+#include <boost/function.hpp>
+#include <Tools/console.h>
+#include <Tools/mqttconnection.h>
+#include <Tools/outboundbuffer.h>
+#include <Tools/payloadcache.h>
+#include <Tools/heartbeat.h>
+#include <Tools/deliverytracker.h>
+#include <Tools/outboundjournal.h>
+#include <Tools/requestcontext.h>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The MqttSession class
+ * MQTT v5 client shared by every robot context of the process: one client id, one socket, one
+ * network thread and one outbound window whatever the number of robots driven. Each context owns
+ * a topic namespace, the first level of its topics (<namespace>/robot_status). Inbound messages
+ * are handed to the context registered for their first topic level, a single hash lookup, with
+ * the namespace stripped. Topics without a registered namespace go to the context attached with
+ * an empty one, if any.
+ * Connection, heartbeat and offline buffering are those of a single robot client, see
+ * RobotCommunication. Create and use from the GUI thread, publishing is thread safe.
+ */
+class MqttSession : public QObject
+{
+    Q_OBJECT
+
+    public:
+        struct ServerOptions
+        {
+            std::vector<std::string> servers = {"localhost:1883"};  // Order of preference, failover to the next on connect failure
+            int switch_back_interval_ms = 10000;                    // Primary probe period while on a fallback broker, 0 stays
+            std::string client_id = "robot";
+            bool unique_client_id = true;                           // Append -<host>[-<instance>], stable across restarts so the session is resumed
+            std::string instance_id;                                // Tells instances on one host apart, empty derives it from the journal
+            std::string command_topic = "robot_depart";             // Per robot, within its namespace
+            bool robot_namespace = true;                            // Prefix the topics of each robot with its name
+        };
+
+        struct LinkOptions
+        {
+            int keep_alive_s = 10;                          // MQTT keep-alive, the broker drops the client (and sends the will) after 1.5x
+            std::string presence_topic = "robot_presence";  // Client presence on <presence_topic>/<client id>, the will of all robots
+            std::string heartbeat_topic = "robot_heartbeat";// Pings go to <heartbeat_topic>/<client id>
+            int heartbeat_interval_ms = 1000;               // 0 disables the heartbeat
+            int heartbeat_timeout_ms = 3000;
+            int heartbeat_max_missed = 3;                   // Consecutive missed pings before reconnecting
+            int session_expiry_s = 300;                     // Broker keeps subscriptions and queued commands this long after a disconnect
+            int inflight_window = 32;                       // Unacknowledged QoS 1 publishes, further ones wait in the outbound buffer
+            int ack_timeout_ms = 10000;                     // In-flight slot released without PUBACK after this long
+            int max_retries = 3;                            // Republish attempts of a failed delivery
+            std::string journal_file;                       // Durable messages kept on disk until acknowledged, empty disables
+            int journal_sync_interval_ms = 200;             // Batched fdatasync of the journal
+        };
+
+        typedef boost::function<void (const std::string &topic, const std::string &payload, const RequestContext &request)> Receiver;
+
+        /**
+         * @brief shared    Session of the process, created by the first caller and destroyed
+         *                  with the last reference. Logs go to the console of a joined context.
+         */
+        static std::shared_ptr<MqttSession> shared(Console *console);
+
+        ~MqttSession();
+
+        /**
+         * @brief join      Register the console of a context, leave before deleting it
+         */
+        void join(Console *console);
+        void leave(Console *console);
+
+        /**
+         * @brief setServerOptions / setLinkOptions     Ignored once started, the first robot
+         *                                              to start configures the session
+         */
+        void setServerOptions(const ServerOptions &options);
+        void setLinkOptions(const LinkOptions &options);
+
+        /**
+         * @brief presenceTopic <presence_topic>/<client id>. Retained {"status": "online"} once
+         *                      connected, {"status": "offline"} as the will of the connection and
+         *                      on shutdown. A connection carries a single will, so it stands for
+         *                      every robot of the session. Empty before start.
+         */
+        const std::string &presenceTopic(void) const;
+
+        /**
+         * @brief start     Create the client and begin connecting, once. Never blocks.
+         */
+        void start(void);
+        bool started(void) const;
+
+        /**
+         * @brief attach    Messages whose first topic level is name_space go to receiver, on the
+         *                  paho thread, with the namespace level removed
+         * @return false if the namespace is already attached
+         */
+        bool attach(const std::string &name_space, Receiver receiver);
+
+        /**
+         * @brief detach    Waits for a message being handed to the namespace's receiver
+         */
+        void detach(const std::string &name_space);
+
+        /**
+         * @brief addSubscription / removeSubscription  Broker subscriptions, kept across reconnects
+         */
+        void addSubscription(const std::string &topic, int qos);
+        void removeSubscription(const std::string &topic);
+
+        /**
+         * @brief enqueue   Publish, or buffer while offline or while the in-flight window is full
+         * @param durable   Also journaled until the broker acknowledges it, replayed by the next
+         *                  run if it never does
+         * @param content_type  Sent as the MQTT v5 content type, NULL for none. Must outlive the message.
+         */
+        void enqueue(const std::string &topic, const Payload &payload, bool retained, const std::string &correlation_data = "",
+                     bool durable = false, const char *content_type = NULL);
+
+        void addCoalescedTopic(const std::string &topic);
+        void setOutboundCapacity(size_t capacity);
+
+        bool isReady(void) const;
+        MqttConnection::State connectionState(void) const;
+        std::string currentServer(void) const;
+        const std::string &clientId(void) const;
+        const ServerOptions &serverOptions(void) const;
+        const LinkOptions &linkOptions(void) const;
+
+        // Offline buffer statistics
+        size_t outboundDepth(void);
+        uint64_t outboundDroppedCount(void) const;
+        uint64_t outboundCoalescedCount(void) const;
+
+        Heartbeat::Stats heartbeatStats(void);
+        DeliveryTracker::Stats deliveryStats(void);
+        OutboundJournal::Stats journalStats(void);
+
+        // Robot contexts attached, and inbound messages no context claimed
+        size_t contextCount(void);
+        uint64_t unroutedCount(void) const;
+
+    signals:
+        void readyChanged(bool ready);
+        void heartbeatUpdated(void);
+
+    private slots:
+        void flushOutbound(bool ready);
+        void sendHeartbeat(void);
+
+    private:
+        /**
+         * Delivery results of tracked publishes, the sequence number travels as user context
+         */
+        class DeliveryListener : public mqtt::iaction_listener
+        {
+            public:
+                DeliveryListener(MqttSession *owner) : owner_(owner) {}
+                void on_success(const mqtt::token &tok) override;
+                void on_failure(const mqtt::token &tok) override;
+
+            private:
+                MqttSession *owner_;
+        };
+
+        MqttSession(Console *console);
+
+        const int  QOS = 1;
+
+        mqtt::connect_options connOpts;
+        mqtt::async_client* cli = NULL;
+        MqttConnection *connection_ = NULL;
+        ServerOptions server_options_;
+        LinkOptions link_options_;
+        std::string client_id_;
+        std::string presence_topic_;
+
+        Heartbeat heartbeat_;
+        std::string heartbeat_topic_;
+        QTimer *heartbeat_timer_;
+
+        // Messages published while not connected, sent in order once the connection is ready
+        std::mutex publish_mtx_;
+        OutboundBuffer outbound_;
+        DeliveryTracker delivery_;
+        DeliveryListener delivery_listener_;
+        OutboundJournal *journal_ = NULL;
+        std::vector<OutboundMessage> parked_;   // Durable messages past max_retries, see check_status
+
+        // Robot contexts by namespace, held while a message is handed over
+        std::mutex contexts_mtx_;
+        std::unordered_map<std::string, Receiver> contexts_;
+        std::atomic<uint64_t> unrouted_;
+
+        // Broker subscriptions to add once the connection exists
+        std::vector<std::pair<std::string, int>> subscriptions_;
+
+        std::vector<Console *> consoles_;
+        Console *console_;
+        QTimer *timer_;
+
+        void connect_client();
+        /**
+         * @brief openJournal   @return false if another instance holds the journal
+         */
+        bool openJournal(void);
+        void check_status(void);
+        void route(mqtt::const_message_ptr msg);
+        bool send(const OutboundMessage &msg);
+        size_t drainOutbound(void);
+        void onDelivery(uint64_t seq, bool delivered, int reason);
+};
+
+#endif // MQTTSESSION_H
@@ -0,0 +1,138 @@
+#include "outboundbuffer.h"
+
+OutboundBuffer::OutboundBuffer(size_t capacity)
+{
+    capacity_ = (capacity > 0)? capacity : 1;
+    dropped_ = 0;
+    coalesced_ = 0;
+    buffered_ = 0;
+}
+
+void OutboundBuffer::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    capacity_ = (capacity > 0)? capacity : 1;
+    trim();
+}
+
+void OutboundBuffer::addCoalescedTopic(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    coalesced_topics_.insert(topic);
+}
+
+void OutboundBuffer::push(const OutboundMessage &msg)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    buffered_++;
+
+    if (coalesced_topics_.count(msg.topic) > 0)
+    {
+        auto it = latest_.find(msg.topic);
+        if (it != latest_.end())
+        {
+            // Only the latest state matters, the stale one is never sent
+            messages_.erase(it->second);
+            coalesced_++;
+        }
+        messages_.push_back(msg);
+        latest_[msg.topic] = std::prev(messages_.end());
+    }
+    else
+    {
+        messages_.push_back(msg);
+    }
+    trim();
+}
+
+bool OutboundBuffer::pop(OutboundMessage &msg)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (messages_.empty())
+    {
+        return false;
+    }
+    msg = messages_.front();
+    erase(messages_.begin());
+    return true;
+}
+
+void OutboundBuffer::pushFront(const OutboundMessage &msg)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (coalesced_topics_.count(msg.topic) > 0)
+    {
+        if (latest_.count(msg.topic) > 0)
+        {
+            coalesced_++;
+            return;
+        }
+        messages_.push_front(msg);
+        latest_[msg.topic] = messages_.begin();
+    }
+    else
+    {
+        messages_.push_front(msg);
+    }
+    trim();
+}
+
+size_t OutboundBuffer::depth()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return messages_.size();
+}
+
+bool OutboundBuffer::empty()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return messages_.empty();
+}
+
+uint64_t OutboundBuffer::droppedCount() const
+{
+    return dropped_;
+}
+
+uint64_t OutboundBuffer::coalescedCount() const
+{
+    return coalesced_;
+}
+
+uint64_t OutboundBuffer::bufferedCount() const
+{
+    return buffered_;
+}
+
+void OutboundBuffer::resetCounters()
+{
+    dropped_ = 0;
+    coalesced_ = 0;
+    buffered_ = 0;
+}
+
+void OutboundBuffer::erase(MessageList::iterator it)
+{
+    auto latest = latest_.find(it->topic);
+    if (latest != latest_.end() && latest->second == it)
+    {
+        latest_.erase(latest);
+    }
+    messages_.erase(it);
+}
+
+void OutboundBuffer::trim()
+{
+    auto it = messages_.begin();
+    while (messages_.size() > capacity_ && it != messages_.end())
+    {
+        if (it->journal_id != 0)
+        {
+            ++it;
+            continue;
+        }
+        auto dropped = it++;
+        erase(dropped);
+        dropped_++;
+    }
+}
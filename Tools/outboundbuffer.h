@@ -0,0 +1,86 @@
+#ifndef OUTBOUNDBUFFER_H
+#define OUTBOUNDBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "payloadcache.h"
+
+/**
+ * @brief The OutboundMessage struct
+ * MQTT message waiting for a connection
+ */
+struct OutboundMessage
+{
+    std::string topic;
+    Payload payload;
+    int qos = 1;
+    bool retained = false;
+    std::string correlation_data;   // MQTT v5 reply to a request, see RequestContext
+    int failed_attempts = 0;        // See DeliveryTracker
+    uint64_t journal_id = 0;        // Durable message, see OutboundJournal
+    const char *content_type = NULL;// MQTT v5 content type of an encoded payload, static string
+};
+
+/**
+ * @brief The OutboundBuffer class
+ * Bounded FIFO of messages published while the broker is unreachable. On coalesced topics
+ * (state topics such as robot_status) only the latest message is kept: a new one replaces the
+ * buffered one and moves to the back of the queue. When full, the oldest message is dropped,
+ * except durable ones (journal_id set): those are only ever removed by sending them, past the
+ * capacity if need be, as the journal on disk bounds them. Thread safe.
+ */
+class OutboundBuffer
+{
+    public:
+        OutboundBuffer(size_t capacity = 256);
+
+        void setCapacity(size_t capacity);
+        void addCoalescedTopic(const std::string &topic);
+
+        /**
+         * @brief push      Append msg, replacing the buffered message of a coalesced topic
+         */
+        void push(const OutboundMessage &msg);
+
+        /**
+         * @brief pop       Oldest message
+         * @return false if the buffer is empty
+         */
+        bool pop(OutboundMessage &msg);
+
+        /**
+         * @brief pushFront Put back a message whose send failed, it stays first in line.
+         *                  Ignored if a newer message of the same coalesced topic is buffered.
+         */
+        void pushFront(const OutboundMessage &msg);
+
+        size_t depth(void);
+        bool empty(void);
+        uint64_t droppedCount(void) const;
+        uint64_t coalescedCount(void) const;
+        uint64_t bufferedCount(void) const;
+        void resetCounters(void);
+
+    private:
+        typedef std::list<OutboundMessage> MessageList;
+
+        std::mutex mtx_;
+        size_t capacity_;
+        MessageList messages_;
+        std::set<std::string> coalesced_topics_;
+        std::unordered_map<std::string, MessageList::iterator> latest_;
+
+        std::atomic<uint64_t> dropped_;
+        std::atomic<uint64_t> coalesced_;
+        std::atomic<uint64_t> buffered_;
+
+        void erase(MessageList::iterator it);
+        void trim(void);
+};
+
+#endif // OUTBOUNDBUFFER_H
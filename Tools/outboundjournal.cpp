@@ -0,0 +1,334 @@
+#include "outboundjournal.h"
+#include "crashhandler.h"
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    bool writeAll(int fd, const char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+}
+
+OutboundJournal::OutboundJournal(int sync_interval_ms, uint64_t compact_bytes)
+{
+    sync_interval_ = std::chrono::milliseconds(sync_interval_ms > 0? sync_interval_ms : 1);
+    compact_bytes_ = compact_bytes;
+    flusher_thread_ = new std::thread(&OutboundJournal::flusherRun, this);
+}
+
+OutboundJournal::~OutboundJournal()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    cond_.notify_all();
+    flusher_thread_->join();
+    delete flusher_thread_;
+
+    if (fd_ >= 0)
+    {
+        fdatasync(fd_);
+        close(fd_);
+    }
+}
+
+bool OutboundJournal::open(const std::string &file_name, std::vector<OutboundMessage> &replay)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (fd_ >= 0)
+    {
+        return false;
+    }
+    file_name_ = file_name;
+    int fd = ::open(file_name_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    // One process per journal, another instance would replay our results
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        // errno stays EWOULDBLOCK for the caller
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    fd_ = fd;
+    return this->replay(replay);
+}
+
+bool OutboundJournal::isOpen() const
+{
+    return fd_ >= 0;
+}
+
+bool OutboundJournal::replay(std::vector<OutboundMessage> &replayed)
+{
+    // Called with mtx_ held
+    struct stat st;
+    if (fstat(fd_, &st) != 0)
+    {
+        return false;
+    }
+    std::string content(static_cast<size_t>(st.st_size), '\0');
+    size_t read_bytes = 0;
+    while (read_bytes < content.size())
+    {
+        ssize_t n = pread(fd_, &content[read_bytes], content.size() - read_bytes, static_cast<off_t>(read_bytes));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        read_bytes += static_cast<size_t>(n);
+    }
+    content.resize(read_bytes);
+
+    size_t offset = 0;
+    while (content.size() - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader header;
+        memcpy(&header, content.data() + offset, sizeof(header));
+        if (header.magic != RECORD_MAGIC || header.topic_length > MAX_FIELD_LENGTH ||
+            header.payload_length > MAX_FIELD_LENGTH || header.correlation_length > MAX_FIELD_LENGTH)
+        {
+            break;
+        }
+        size_t length = sizeof(header) + header.topic_length + header.payload_length + header.correlation_length;
+        if (content.size() - offset < length)
+        {
+            // Torn by a crash while appending
+            break;
+        }
+        uint32_t crc = header.crc;
+        memset(&content[offset + offsetof(RecordHeader, crc)], 0, sizeof(header.crc));
+        if (crc32(0, reinterpret_cast<const Bytef *>(content.data() + offset), static_cast<uInt>(length)) != crc)
+        {
+            break;
+        }
+
+        if (header.type == kRecordMessage)
+        {
+            const char *body = content.data() + offset + sizeof(header);
+            OutboundMessage &msg = pending_[header.id];
+            msg.topic.assign(body, header.topic_length);
+            msg.payload = std::make_shared<const std::string>(body + header.topic_length, header.payload_length);
+            msg.correlation_data.assign(body + header.topic_length + header.payload_length, header.correlation_length);
+            msg.retained = (header.flags & kFlagRetained) != 0;
+            msg.journal_id = header.id;
+        }
+        else if (header.type == kRecordAck)
+        {
+            pending_.erase(header.id);
+        }
+        next_id_ = std::max(next_id_, header.id + 1);
+        offset += length;
+    }
+
+    if (offset < content.size())
+    {
+        // Appends continue after the last valid record
+        if (ftruncate(fd_, static_cast<off_t>(offset)) != 0)
+        {
+            return false;
+        }
+        dirty_ = true;
+    }
+    stats_.file_bytes = offset;
+    stats_.replayed = pending_.size();
+    for (const auto &entry : pending_)
+    {
+        live_bytes_ += recordSize(entry.second);
+        replayed.push_back(entry.second);
+    }
+    return true;
+}
+
+uint64_t OutboundJournal::append(const OutboundMessage &msg)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (fd_ < 0)
+    {
+        return 0;
+    }
+    uint64_t id = next_id_++;
+    if (!write(fd_, kRecordMessage, id, &msg))
+    {
+        return 0;
+    }
+    OutboundMessage &pending = pending_[id];
+    pending = msg;
+    pending.journal_id = id;
+    live_bytes_ += recordSize(msg);
+    stats_.appended++;
+    return id;
+}
+
+void OutboundJournal::acknowledge(uint64_t id)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = pending_.find(id);
+    if (fd_ < 0 || it == pending_.end())
+    {
+        return;
+    }
+    live_bytes_ -= recordSize(it->second);
+    pending_.erase(it);
+    stats_.acknowledged++;
+    // Even with nothing left pending: an append may land before the next compaction truncates
+    write(fd_, kRecordAck, id, NULL);
+}
+
+uint64_t OutboundJournal::recordSize(const OutboundMessage &msg)
+{
+    return sizeof(RecordHeader) + msg.topic.size() + msg.payload->size() + msg.correlation_data.size();
+}
+
+bool OutboundJournal::write(int fd, RecordType type, uint64_t id, const OutboundMessage *msg)
+{
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.type = type;
+    header.id = id;
+    if (msg != NULL)
+    {
+        header.flags = msg->retained? kFlagRetained : 0;
+        header.topic_length = static_cast<uint32_t>(msg->topic.size());
+        header.payload_length = static_cast<uint32_t>(msg->payload->size());
+        header.correlation_length = static_cast<uint32_t>(msg->correlation_data.size());
+    }
+
+    record_.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (msg != NULL)
+    {
+        record_.append(msg->topic);
+        record_.append(*msg->payload);
+        record_.append(msg->correlation_data);
+    }
+    header.crc = crc32(0, reinterpret_cast<const Bytef *>(record_.data()), static_cast<uInt>(record_.size()));
+    memcpy(&record_[offsetof(RecordHeader, crc)], &header.crc, sizeof(header.crc));
+
+    if (!writeAll(fd, record_.data(), record_.size()))
+    {
+        // A partial record would hide every later one from the replay
+        if (fd == fd_ && ftruncate(fd, static_cast<off_t>(stats_.file_bytes)) != 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+        return false;
+    }
+    if (fd == fd_)
+    {
+        stats_.file_bytes += record_.size();
+    }
+    dirty_ = true;
+    return true;
+}
+
+void OutboundJournal::compact()
+{
+    if (pending_.empty())
+    {
+        if (stats_.file_bytes > 0 && ftruncate(fd_, 0) == 0)
+        {
+            stats_.file_bytes = 0;
+            stats_.compactions++;
+            dirty_ = true;
+        }
+        return;
+    }
+    // Rewriting costs the live records, worth it once they are less than half of the file
+    if (stats_.file_bytes <= compact_bytes_ || stats_.file_bytes <= 2 * live_bytes_)
+    {
+        return;
+    }
+
+    // Pending records only, swapped in once on disk
+    std::string temp_name = file_name_ + ".tmp";
+    int fd = ::open(temp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return;
+    }
+    uint64_t bytes = 0;
+    bool written = flock(fd, LOCK_EX | LOCK_NB) == 0;
+    for (auto it = pending_.begin(); written && it != pending_.end(); ++it)
+    {
+        written = write(fd, kRecordMessage, it->first, &it->second);
+        bytes += record_.size();
+    }
+    if (!written || fdatasync(fd) != 0 || rename(temp_name.c_str(), file_name_.c_str()) != 0)
+    {
+        close(fd);
+        unlink(temp_name.c_str());
+        return;
+    }
+    close(fd_);
+    fd_ = fd;
+    stats_.file_bytes = bytes;
+    stats_.compactions++;
+}
+
+void OutboundJournal::flusherRun()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (running_)
+    {
+        cond_.wait_for(lck, sync_interval_);
+        if (fd_ < 0)
+        {
+            continue;
+        }
+        compact();
+        if (!dirty_)
+        {
+            continue;
+        }
+        dirty_ = false;
+        // fd_ is only replaced by compact, on this thread
+        int fd = fd_;
+        lck.unlock();
+        fdatasync(fd);
+        lck.lock();
+        stats_.syncs++;
+    }
+}
+
+OutboundJournal::Stats OutboundJournal::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = stats_;
+    stats.pending = pending_.size();
+    return stats;
+}
@@ -0,0 +1,123 @@
+#ifndef OUTBOUNDJOURNAL_H
+#define OUTBOUNDJOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "outboundbuffer.h"
+
+/**
+ * @brief The OutboundJournal class
+ * Append-only file of the messages on durable topics (mission results), kept until the broker
+ * acknowledges them, so they survive a restart of the host while the broker is unreachable.
+ * Each record carries a CRC; replay stops at the first torn or corrupt record, which is then
+ * overwritten. Appends only reach the page cache, a flusher thread fdatasync()s them in batches
+ * every sync_interval_ms and compacts the file, so publishing never waits on the disk. A crash
+ * loses at most the last interval, and a result whose acknowledgement was not synced yet is
+ * sent again (at least once).
+ * Thread safe.
+ */
+class OutboundJournal
+{
+    public:
+        struct Stats
+        {
+            size_t pending = 0;             // Appended, not acknowledged yet
+            uint64_t appended = 0;
+            uint64_t acknowledged = 0;
+            uint64_t replayed = 0;
+            uint64_t syncs = 0;
+            uint64_t compactions = 0;
+            uint64_t file_bytes = 0;
+        };
+
+        /**
+         * @brief OutboundJournal
+         * @param sync_interval_ms  Period of the batched fdatasync
+         * @param compact_bytes     File size above which pending records are rewritten to a new file,
+         *                          once they make up less than half of it
+         */
+        OutboundJournal(int sync_interval_ms = 200, uint64_t compact_bytes = 1024 * 1024);
+        ~OutboundJournal();
+
+        /**
+         * @brief open      Open or create file_name, locked against other processes
+         * @param replay    Messages of the previous runs never acknowledged, in publish order.
+         *                  They stay pending under their journal_id.
+         * @return false if the file cannot be opened or is locked, nothing is journaled then
+         */
+        bool open(const std::string &file_name, std::vector<OutboundMessage> &replay);
+        bool isOpen(void) const;
+
+        /**
+         * @brief append    Journal msg
+         * @return Journal id to acknowledge, 0 if the journal is closed or the write failed
+         */
+        uint64_t append(const OutboundMessage &msg);
+
+        /**
+         * @brief acknowledge   The broker has msg. An ack record is appended, its message record
+         *                      is dropped with the next compaction.
+         */
+        void acknowledge(uint64_t id);
+
+        Stats stats(void);
+
+    private:
+        enum RecordType : uint8_t {
+            kRecordMessage = 1,
+            kRecordAck = 2
+        };
+
+        enum RecordFlags : uint8_t {
+            kFlagRetained = 1
+        };
+
+        struct RecordHeader
+        {
+            uint32_t magic;
+            uint8_t type;
+            uint8_t flags;
+            uint16_t reserved;
+            uint64_t id;
+            uint32_t topic_length;
+            uint32_t payload_length;
+            uint32_t correlation_length;
+            uint32_t crc;               // Of the header (crc 0) and the body
+        };
+
+        static const uint32_t RECORD_MAGIC = 0x4a514853;     // "SHQJ"
+        static const uint32_t MAX_FIELD_LENGTH = 64 * 1024 * 1024;
+
+        std::string file_name_;
+        int fd_ = -1;
+        std::chrono::milliseconds sync_interval_;
+        uint64_t compact_bytes_;
+
+        std::mutex mtx_;
+        std::condition_variable cond_;
+        std::map<uint64_t, OutboundMessage> pending_;
+        uint64_t next_id_ = 1;
+        bool dirty_ = false;
+        bool running_ = true;
+        std::string record_;            // Reused record buffer
+        Stats stats_;
+        uint64_t live_bytes_ = 0;       // Message records of pending_, what a compaction keeps
+        std::thread *flusher_thread_ = NULL;
+
+        void flusherRun(void);
+
+        // Called with mtx_ held
+        bool write(int fd, RecordType type, uint64_t id, const OutboundMessage *msg);
+        void compact(void);
+        static uint64_t recordSize(const OutboundMessage &msg);
+
+        bool replay(std::vector<OutboundMessage> &replayed);
+};
+
+#endif // OUTBOUNDJOURNAL_H
@@ -0,0 +1,178 @@
+#include "payloadcache.h"
+
+PayloadCache::PayloadCache(size_t max_entries)
+{
+    max_entries_ = max_entries;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+Payload PayloadCache::get(const std::string &topic, const std::string &field, const std::string &value)
+{
+    return lookup(topic, field, value, 's', value);
+}
+
+Payload PayloadCache::get(const std::string &topic, const std::string &field, bool value)
+{
+    static const std::string TRUE_TEXT("true");
+    static const std::string FALSE_TEXT("false");
+    return lookup(topic, field, value, 'b', value? TRUE_TEXT : FALSE_TEXT);
+}
+
+template <typename T>
+Payload PayloadCache::lookup(const std::string &topic, const std::string &field, const T &value, char type, const std::string &text)
+{
+    // Reused per thread, a lookup does not allocate once the key capacity is reached
+    static thread_local std::string key;
+    key.assign(topic);
+    key.push_back('\0');
+    key.append(field);
+    key.push_back('\0');
+    key.push_back(type);
+    key.append(text);
+
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            hits_++;
+            return it->second;
+        }
+    }
+
+    misses_++;
+    std::string payload;
+    payload.reserve(field.size() + text.size() + 8);
+    formatField(payload, field, value);
+    Payload shared = std::make_shared<const std::string>(std::move(payload));
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (entries_.size() < max_entries_)
+    {
+        entries_.emplace(key, shared);
+    }
+    return shared;
+}
+
+void PayloadCache::formatField(std::string &out, const std::string &field, const std::string &value)
+{
+    out.push_back('{');
+    appendQuoted(out, field);
+    out.push_back(':');
+    appendQuoted(out, value);
+    out.append("}\n", 2);
+}
+
+void PayloadCache::formatField(std::string &out, const std::string &field, bool value)
+{
+    out.push_back('{');
+    appendQuoted(out, field);
+    out.push_back(':');
+    if (value) out.append("true", 4);
+    else out.append("false", 5);
+    out.append("}\n", 2);
+}
+
+void PayloadCache::appendQuoted(std::string &out, const std::string &text)
+{
+    appendQuoted(out, text.data(), text.size());
+}
+
+void PayloadCache::appendQuoted(std::string &out, const char *text, size_t length)
+{
+    out.push_back('"');
+    for (const char *end = text + length; text != end; ++text)
+    {
+        char c = *text;
+        switch (c)
+        {
+            case '"': out.append("\\\"", 2); break;
+            case '\\': out.append("\\\\", 2); break;
+            case '\b': out.append("\\b", 2); break;
+            case '\f': out.append("\\f", 2); break;
+            case '\n': out.append("\\n", 2); break;
+            case '\r': out.append("\\r", 2); break;
+            case '\t': out.append("\\t", 2); break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20 && static_cast<unsigned char>(c) < 0x80)
+                {
+                    out.push_back(c);
+                    break;
+                }
+                // Like jsoncpp: control characters and all of non-ASCII as \u escapes, UTF-16
+                // surrogate pairs past the BMP, U+FFFD for invalid sequences
+                uint32_t codepoint = decodeUtf8(text, end);
+                if (codepoint >= 0x10000)
+                {
+                    codepoint -= 0x10000;
+                    appendEscape(out, 0xD800 + ((codepoint >> 10) & 0x3FF));
+                    appendEscape(out, 0xDC00 + (codepoint & 0x3FF));
+                }
+                else
+                {
+                    appendEscape(out, codepoint);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+void PayloadCache::appendEscape(std::string &out, uint32_t unit)
+{
+    static const char HEX[] = "0123456789abcdef";
+    char escaped[6] = {'\\', 'u', HEX[(unit >> 12) & 0xF], HEX[(unit >> 8) & 0xF], HEX[(unit >> 4) & 0xF], HEX[unit & 0xF]};
+    out.append(escaped, 6);
+}
+
+uint32_t PayloadCache::decodeUtf8(const char *&text, const char *end)
+{
+    // Same decoding as jsoncpp's writer, continuation bytes are not checked
+    static const uint32_t REPLACEMENT = 0xFFFD;
+    const unsigned char *s = reinterpret_cast<const unsigned char *>(text);
+    uint32_t first = s[0];
+    if (first < 0x80)
+    {
+        return first;
+    }
+    if (first < 0xE0)
+    {
+        if (end - text < 2) return REPLACEMENT;
+        uint32_t codepoint = ((first & 0x1F) << 6) | (s[1] & 0x3F);
+        text += 1;
+        return (codepoint < 0x80)? REPLACEMENT : codepoint;
+    }
+    if (first < 0xF0)
+    {
+        if (end - text < 3) return REPLACEMENT;
+        uint32_t codepoint = ((first & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        text += 2;
+        // Surrogates are no code points of their own
+        if (codepoint >= 0xD800 && codepoint <= 0xDFFF) return REPLACEMENT;
+        return (codepoint < 0x800)? REPLACEMENT : codepoint;
+    }
+    if (first < 0xF8)
+    {
+        if (end - text < 4) return REPLACEMENT;
+        uint32_t codepoint = ((first & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        text += 3;
+        return (codepoint < 0x10000)? REPLACEMENT : codepoint;
+    }
+    return REPLACEMENT;
+}
+
+size_t PayloadCache::size()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return entries_.size();
+}
+
+uint64_t PayloadCache::hitCount() const
+{
+    return hits_;
+}
+
+uint64_t PayloadCache::missCount() const
+{
+    return misses_;
+}
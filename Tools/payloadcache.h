@@ -0,0 +1,59 @@
+#ifndef PAYLOADCACHE_H
+#define PAYLOADCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Immutable, shared MQTT payload. Handed to paho as a binary_ref, so publishing never copies it.
+ */
+typedef std::shared_ptr<const std::string> Payload;
+
+/**
+ * @brief The PayloadCache class
+ * Serialized {"<field>": <value>} payloads keyed by (topic, field, value). Each payload is
+ * formatted once, without jsoncpp, and shared by every later publish. The output is identical
+ * to Json::FastWriter, which also writes non-ASCII text as \u escapes. Dynamic values (bed_N)
+ * are cached on first use up to max_entries, past that they are formatted on every call.
+ * Thread safe.
+ */
+class PayloadCache
+{
+    public:
+        PayloadCache(size_t max_entries = 1024);
+
+        Payload get(const std::string &topic, const std::string &field, const std::string &value);
+        Payload get(const std::string &topic, const std::string &field, bool value);
+
+        /**
+         * @brief formatField   Append {"<field>":<value>}\n to out, escaped like Json::FastWriter
+         */
+        static void formatField(std::string &out, const std::string &field, const std::string &value);
+        static void formatField(std::string &out, const std::string &field, bool value);
+        static void appendQuoted(std::string &out, const std::string &text);
+        static void appendQuoted(std::string &out, const char *text, size_t length);
+
+        size_t size(void);
+        uint64_t hitCount(void) const;
+        uint64_t missCount(void) const;
+
+    private:
+        std::mutex mtx_;
+        size_t max_entries_;
+        std::unordered_map<std::string, Payload> entries_;
+
+        std::atomic<uint64_t> hits_;
+        std::atomic<uint64_t> misses_;
+
+        static void appendEscape(std::string &out, uint32_t unit);
+        static uint32_t decodeUtf8(const char *&text, const char *end);
+
+        template <typename T>
+        Payload lookup(const std::string &topic, const std::string &field, const T &value, char type, const std::string &text);
+};
+
+#endif // PAYLOADCACHE_H
@@ -0,0 +1,321 @@
+#include "payloadwriter.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // CBOR major types
+    const uint8_t MAJOR_UNSIGNED = 0;
+    const uint8_t MAJOR_NEGATIVE = 1;
+    const uint8_t MAJOR_TEXT = 3;
+    const uint8_t MAJOR_ARRAY = 4;
+    const uint8_t MAJOR_MAP = 5;
+
+    const uint8_t CBOR_FALSE = 0xf4;
+    const uint8_t CBOR_TRUE = 0xf5;
+    const uint8_t CBOR_NULL = 0xf6;
+    const uint8_t CBOR_FLOAT32 = 0xfa;
+    const uint8_t CBOR_FLOAT64 = 0xfb;
+
+    void appendBigEndian(std::string &out, uint64_t value, int bytes)
+    {
+        char buffer[8];
+        for (int i = bytes - 1; i >= 0; i--)
+        {
+            buffer[i] = static_cast<char>(value & 0xff);
+            value >>= 8;
+        }
+        out.append(buffer, bytes);
+    }
+}
+
+PayloadWriter::PayloadWriter(std::string &out, Format format) :
+    out_(out)
+{
+    format_ = format;
+    out_.clear();
+}
+
+PayloadWriter::Format PayloadWriter::format() const
+{
+    return format_;
+}
+
+const char *PayloadWriter::contentType(Format format)
+{
+    return (format == Format::Cbor)? "application/cbor" : "application/json";
+}
+
+bool PayloadWriter::formatFromString(const std::string &name, Format &format)
+{
+    if (name == "json")
+    {
+        format = Format::Json;
+        return true;
+    }
+    if (name == "cbor")
+    {
+        format = Format::Cbor;
+        return true;
+    }
+    return false;
+}
+
+void PayloadWriter::separator()
+{
+    if (after_key_)
+    {
+        after_key_ = false;
+        return;
+    }
+    if (depth_ > 0 && depth_ <= MAX_DEPTH)
+    {
+        if (!first_[depth_ - 1])
+        {
+            out_.push_back(',');
+        }
+        first_[depth_ - 1] = false;
+    }
+}
+
+void PayloadWriter::open(char bracket)
+{
+    separator();
+    out_.push_back(bracket);
+    if (depth_ < MAX_DEPTH)
+    {
+        first_[depth_] = true;
+    }
+    depth_++;
+}
+
+void PayloadWriter::close(char bracket)
+{
+    out_.push_back(bracket);
+    depth_--;
+    if (depth_ == 0)
+    {
+        // Json::FastWriter ends the document with a newline
+        out_.push_back('\n');
+    }
+}
+
+void PayloadWriter::head(uint8_t major, uint64_t argument)
+{
+    uint8_t initial = static_cast<uint8_t>(major << 5);
+    if (argument < 24)
+    {
+        out_.push_back(static_cast<char>(initial | argument));
+    }
+    else if (argument <= 0xff)
+    {
+        out_.push_back(static_cast<char>(initial | 24));
+        appendBigEndian(out_, argument, 1);
+    }
+    else if (argument <= 0xffff)
+    {
+        out_.push_back(static_cast<char>(initial | 25));
+        appendBigEndian(out_, argument, 2);
+    }
+    else if (argument <= 0xffffffff)
+    {
+        out_.push_back(static_cast<char>(initial | 26));
+        appendBigEndian(out_, argument, 4);
+    }
+    else
+    {
+        out_.push_back(static_cast<char>(initial | 27));
+        appendBigEndian(out_, argument, 8);
+    }
+}
+
+void PayloadWriter::text(const char *text, size_t length)
+{
+    if (format_ == Format::Cbor)
+    {
+        head(MAJOR_TEXT, length);
+        out_.append(text, length);
+        return;
+    }
+    separator();
+    PayloadCache::appendQuoted(out_, text, length);
+}
+
+void PayloadWriter::beginMap(size_t pairs)
+{
+    if (format_ == Format::Cbor)
+    {
+        head(MAJOR_MAP, pairs);
+        return;
+    }
+    open('{');
+}
+
+void PayloadWriter::endMap()
+{
+    if (format_ == Format::Json)
+    {
+        close('}');
+    }
+}
+
+void PayloadWriter::beginArray(size_t items)
+{
+    if (format_ == Format::Cbor)
+    {
+        head(MAJOR_ARRAY, items);
+        return;
+    }
+    open('[');
+}
+
+void PayloadWriter::endArray()
+{
+    if (format_ == Format::Json)
+    {
+        close(']');
+    }
+}
+
+void PayloadWriter::key(const char *name)
+{
+    text(name, strlen(name));
+    if (format_ == Format::Json)
+    {
+        out_.push_back(':');
+        after_key_ = true;
+    }
+}
+
+void PayloadWriter::value(bool flag)
+{
+    if (format_ == Format::Cbor)
+    {
+        out_.push_back(static_cast<char>(flag? CBOR_TRUE : CBOR_FALSE));
+        return;
+    }
+    separator();
+    if (flag) out_.append("true", 4);
+    else out_.append("false", 5);
+}
+
+void PayloadWriter::value(int number)
+{
+    value(static_cast<int64_t>(number));
+}
+
+void PayloadWriter::value(int64_t number)
+{
+    if (format_ == Format::Cbor)
+    {
+        if (number >= 0) head(MAJOR_UNSIGNED, static_cast<uint64_t>(number));
+        else head(MAJOR_NEGATIVE, static_cast<uint64_t>(-1 - number));
+        return;
+    }
+    separator();
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(number));
+    out_.append(buffer, length);
+}
+
+void PayloadWriter::value(double number)
+{
+    if (format_ == Format::Cbor)
+    {
+        // Single precision whenever it is exact, poses and percentages mostly are not
+        float single = static_cast<float>(number);
+        if (static_cast<double>(single) == number || std::isnan(number))
+        {
+            uint32_t bits;
+            memcpy(&bits, &single, sizeof(bits));
+            out_.push_back(static_cast<char>(CBOR_FLOAT32));
+            appendBigEndian(out_, bits, 4);
+        }
+        else
+        {
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            out_.push_back(static_cast<char>(CBOR_FLOAT64));
+            appendBigEndian(out_, bits, 8);
+        }
+        return;
+    }
+    separator();
+    if (!std::isfinite(number))
+    {
+        out_.append("null", 4);
+        return;
+    }
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.17g", number);
+    out_.append(buffer, length);
+    if (strpbrk(buffer, ".eE") == NULL)
+    {
+        out_.append(".0", 2);
+    }
+}
+
+void PayloadWriter::value(const char *text)
+{
+    this->text(text, strlen(text));
+}
+
+void PayloadWriter::value(const std::string &text)
+{
+    this->text(text.data(), text.size());
+}
+
+void PayloadWriter::null()
+{
+    if (format_ == Format::Cbor)
+    {
+        out_.push_back(static_cast<char>(CBOR_NULL));
+        return;
+    }
+    separator();
+    out_.append("null", 4);
+}
+
+PayloadPool::PayloadPool(size_t buffers, size_t reserve)
+{
+    max_buffers_ = buffers;
+    reserve_ = reserve;
+    reused_ = 0;
+    allocated_ = 0;
+}
+
+std::shared_ptr<std::string> PayloadPool::acquire()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    // Round robin from the last buffer handed out, the oldest is the likeliest to be free
+    for (size_t i = 0; i < buffers_.size(); i++)
+    {
+        std::shared_ptr<std::string> &buffer = buffers_[(next_ + i) % buffers_.size()];
+        if (buffer.use_count() == 1)
+        {
+            next_ = (next_ + i + 1) % buffers_.size();
+            reused_++;
+            return buffer;
+        }
+    }
+
+    std::shared_ptr<std::string> buffer = std::make_shared<std::string>();
+    buffer->reserve(reserve_);
+    allocated_++;
+    if (buffers_.size() < max_buffers_)
+    {
+        buffers_.push_back(buffer);
+    }
+    return buffer;
+}
+
+uint64_t PayloadPool::reusedCount() const
+{
+    return reused_;
+}
+
+uint64_t PayloadPool::allocatedCount() const
+{
+    return allocated_;
+}
@@ -0,0 +1,113 @@
+#ifndef PAYLOADWRITER_H
+#define PAYLOADWRITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "payloadcache.h"
+
+/**
+ * @brief The PayloadWriter class
+ * Serializes maps and arrays of fields as JSON (formatted like Json::FastWriter) or as CBOR
+ * (RFC 8949, two thirds of the size for numeric telemetry) into a caller provided buffer. It
+ * only appends to the buffer, so once the buffer has grown to the payload size encoding
+ * allocates nothing. Maps and arrays give their size up front, as CBOR definite-length items
+ * need it.
+ */
+class PayloadWriter
+{
+    public:
+        enum class Format {
+            Json,
+            Cbor
+        };
+
+        /**
+         * @brief PayloadWriter     Clears out, keeping its capacity
+         */
+        PayloadWriter(std::string &out, Format format);
+
+        void beginMap(size_t pairs);
+        void endMap(void);
+        void beginArray(size_t items);
+        void endArray(void);
+
+        void key(const char *name);
+        void value(bool flag);
+        void value(int number);
+        void value(int64_t number);
+        void value(double number);
+        void value(const char *text);
+        void value(const std::string &text);
+        void null(void);
+
+        template <typename T>
+        void field(const char *name, const T &v)
+        {
+            key(name);
+            value(v);
+        }
+
+        Format format(void) const;
+
+        /**
+         * @brief contentType   MQTT v5 content type of the format
+         */
+        static const char *contentType(Format format);
+        static bool formatFromString(const std::string &name, Format &format);
+
+    private:
+        static const int MAX_DEPTH = 16;
+
+        std::string &out_;
+        Format format_;
+
+        // JSON separators: whether the next item of each open container is its first
+        bool first_[MAX_DEPTH];
+        int depth_ = 0;
+        bool after_key_ = false;
+
+        void separator(void);
+        void open(char bracket);
+        void close(char bracket);
+        void head(uint8_t major, uint64_t argument);
+        void text(const char *text, size_t length);
+};
+
+/**
+ * @brief The PayloadPool class
+ * Reusable payload buffers for PayloadWriter. A buffer goes back to the pool as soon as the
+ * last message referencing it (outbound buffer, in-flight window, paho) releases it, so a steady
+ * stream of telemetry publishes does not allocate payloads. The paho message wrapping each one
+ * is still allocated per publish (make_message, 2 allocations). Thread safe.
+ */
+class PayloadPool
+{
+    public:
+        /**
+         * @brief PayloadPool
+         * @param buffers   Buffers kept, past that acquire hands out one-off buffers
+         * @param reserve   Initial capacity of each buffer
+         */
+        PayloadPool(size_t buffers = 32, size_t reserve = 256);
+
+        std::shared_ptr<std::string> acquire(void);
+
+        uint64_t reusedCount(void) const;
+        uint64_t allocatedCount(void) const;
+
+    private:
+        std::mutex mtx_;
+        size_t max_buffers_;
+        size_t reserve_;
+        size_t next_ = 0;
+        std::vector<std::shared_ptr<std::string>> buffers_;
+
+        std::atomic<uint64_t> reused_;
+        std::atomic<uint64_t> allocated_;
+};
+
+#endif // PAYLOADWRITER_H
@@ -0,0 +1,281 @@
+#include "ratelimiter.h"
+#include <algorithm>
+#include <cmath>
+
+RateLimiter::RateLimiter(size_t max_buckets, int notice_interval_ms)
+{
+    max_buckets_ = (max_buckets > 0)? max_buckets : 1;
+    notice_interval_ = std::chrono::milliseconds(notice_interval_ms);
+}
+
+void RateLimiter::setLimit(const std::string &topic, const Limit &limit)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lck(mtx_);
+    Limit &stored = limits_[topic];
+    stored = limit;
+    stored.burst = std::max(stored.burst, 1);
+    stored.topic_burst = std::max(stored.topic_burst, 1);
+
+    // Configuration time, the buckets start over with the new limit
+    std::string suffix = std::string(1, '\0') + topic;
+    std::string priority_suffix = suffix + '\0';
+    auto endsWith = [](const std::string &key, const std::string &end) {
+        return key.size() >= end.size() && key.compare(key.size() - end.size(), end.size(), end) == 0;
+    };
+    for (auto it = buckets_.begin(); it != buckets_.end();)
+    {
+        if (endsWith(it->first, suffix) || endsWith(it->first, priority_suffix))
+        {
+            holding_ -= it->second.holding? 1 : 0;
+            it = buckets_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    topic_buckets_[topic] = makeBucket(stored.topic_rate, stored.topic_burst, stored.policy, now);
+    // The reserved lane is capped for all senders together too, at the topic cap or else the
+    // limit of a single sender
+    bool capped = stored.topic_rate > 0;
+    topic_buckets_[topic + '\0'] = makeBucket(capped? stored.topic_rate : stored.rate,
+                                              capped? stored.topic_burst : stored.burst, Policy::Drop, now);
+}
+
+bool RateLimiter::limited(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto it = limits_.find(topic);
+    return it != limits_.end() && it->second.rate > 0;
+}
+
+bool RateLimiter::coalescing()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    for (const auto &limit : limits_)
+    {
+        if (limit.second.rate > 0 && limit.second.policy == Policy::Coalesce)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+RateLimiter::Bucket RateLimiter::makeBucket(double rate, int burst, Policy policy, Clock::time_point now)
+{
+    Bucket bucket;
+    bucket.rate = rate;
+    bucket.burst = burst;
+    bucket.policy = policy;
+    bucket.tokens = burst;
+    bucket.updated = now;
+    bucket.seen = now;
+    bucket.last_notice = now - notice_interval_;
+    return bucket;
+}
+
+void RateLimiter::refill(Bucket &bucket, Clock::time_point now)
+{
+    double elapsed_s = std::chrono::duration<double>(now - bucket.updated).count();
+    bucket.tokens = std::min(bucket.tokens + elapsed_s * bucket.rate, static_cast<double>(bucket.burst));
+    bucket.updated = now;
+}
+
+bool RateLimiter::take(Bucket &bucket)
+{
+    // Buckets without a rate never run out
+    return bucket.rate <= 0 || bucket.tokens >= 1;
+}
+
+RateLimiter::Decision RateLimiter::check(const std::string &source, const std::string &topic, const std::string &payload,
+                                         const RequestContext &request, bool priority, Rejection &rejection)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lck(mtx_);
+    auto limit = limits_.find(topic);
+    if (limit == limits_.end() || limit->second.rate <= 0)
+    {
+        return Decision::Accept;
+    }
+
+    std::string key = source + '\0' + topic;
+    Bucket *shared = NULL;
+    if (priority)
+    {
+        key.push_back('\0');
+        shared = &topic_buckets_[topic + '\0'];
+    }
+    else if (limit->second.topic_rate > 0)
+    {
+        shared = &topic_buckets_[topic];
+    }
+    if (shared != NULL)
+    {
+        refill(*shared, now);
+    }
+
+    auto it = buckets_.find(key);
+    if (it == buckets_.end())
+    {
+        if (shared != NULL && !take(*shared) && (priority || limit->second.policy == Policy::Drop))
+        {
+            // Dropped whatever the sender's bucket says, creating one would only evict others'
+            rejection.topic_limit = true;
+            stats_.topic_limited++;
+            notice(*shared, rejection, now);
+            stats_.dropped++;
+            return Decision::Drop;
+        }
+        if (buckets_.size() >= max_buckets_)
+        {
+            evict(now);
+        }
+        Bucket bucket = makeBucket(limit->second.rate, limit->second.burst, priority? Policy::Drop : limit->second.policy, now);
+        bucket.shared = shared;
+        it = buckets_.emplace(key, bucket).first;
+    }
+    Bucket &bucket = it->second;
+    bucket.seen = now;
+    refill(bucket, now);
+
+    // A held message goes first, a newer one may not overtake it
+    bool sender_ok = take(bucket) && !bucket.holding;
+    bool topic_ok = bucket.shared == NULL || take(*bucket.shared);
+    if (sender_ok && topic_ok)
+    {
+        bucket.tokens -= 1;
+        if (bucket.shared != NULL)
+        {
+            bucket.shared->tokens -= 1;
+        }
+        stats_.accepted++;
+        if (priority)
+        {
+            stats_.priority++;
+        }
+        return Decision::Accept;
+    }
+
+    // Notices of the per-topic cap are throttled per topic, whatever the senders claim to be
+    Bucket &limiting = sender_ok? *bucket.shared : bucket;
+    rejection.topic_limit = sender_ok;
+    if (sender_ok)
+    {
+        stats_.topic_limited++;
+    }
+    notice(limiting, rejection, now);
+
+    if (bucket.policy == Policy::Drop)
+    {
+        stats_.dropped++;
+        return Decision::Drop;
+    }
+    if (bucket.holding)
+    {
+        stats_.coalesced++;
+    }
+    else
+    {
+        bucket.holding = true;
+        holding_++;
+    }
+    bucket.held.topic = topic;
+    bucket.held.payload = payload;
+    bucket.held.request = request;
+    return Decision::Coalesced;
+}
+
+void RateLimiter::notice(Bucket &limiting, Rejection &rejection, Clock::time_point now)
+{
+    limiting.rejected++;
+    rejection.rejected = limiting.rejected;
+    rejection.retry_after_ms = static_cast<int>(std::ceil(std::max(1 - limiting.tokens, 0.0) * 1000 / limiting.rate));
+    if (now - limiting.last_notice >= notice_interval_)
+    {
+        rejection.notify = true;
+        limiting.last_notice = now;
+        limiting.rejected = 0;
+    }
+}
+
+void RateLimiter::release(std::vector<Held> &ready)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lck(mtx_);
+    if (holding_ == 0)
+    {
+        return;
+    }
+    for (auto &entry : buckets_)
+    {
+        Bucket &bucket = entry.second;
+        if (!bucket.holding)
+        {
+            continue;
+        }
+        refill(bucket, now);
+        if (bucket.shared != NULL)
+        {
+            refill(*bucket.shared, now);
+        }
+        if (!take(bucket) || (bucket.shared != NULL && !take(*bucket.shared)))
+        {
+            continue;
+        }
+        bucket.tokens -= 1;
+        if (bucket.shared != NULL)
+        {
+            bucket.shared->tokens -= 1;
+        }
+        bucket.holding = false;
+        holding_--;
+        ready.push_back(std::move(bucket.held));
+        stats_.released++;
+    }
+}
+
+void RateLimiter::evict(Clock::time_point now)
+{
+    // Called with mtx_ held. Refilled buckets first, they behave exactly like new ones.
+    for (auto it = buckets_.begin(); it != buckets_.end();)
+    {
+        refill(it->second, now);
+        if (!it->second.holding && it->second.tokens >= it->second.burst)
+        {
+            it = buckets_.erase(it);
+            stats_.evicted++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (buckets_.size() < max_buckets_)
+    {
+        return;
+    }
+
+    // Otherwise the least recently active
+    auto oldest = std::min_element(buckets_.begin(), buckets_.end(),
+                                   [](const std::pair<const std::string, Bucket> &a, const std::pair<const std::string, Bucket> &b) {
+                                       return a.second.seen < b.second.seen;
+                                   });
+    if (oldest->second.holding)
+    {
+        holding_--;
+        stats_.dropped++;
+    }
+    buckets_.erase(oldest);
+    stats_.evicted++;
+}
+
+RateLimiter::Stats RateLimiter::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = stats_;
+    stats.buckets = buckets_.size();
+    stats.held = holding_;
+    return stats;
+}
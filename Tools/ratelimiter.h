@@ -0,0 +1,146 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "requestcontext.h"
+
+/**
+ * @brief The RateLimiter class
+ * Token buckets for inbound MQTT messages, one per source and topic, so a flooding sender only
+ * exhausts its own bucket. MQTT does not tell who published a message: sources are told apart
+ * by their response topic, per client by convention, and messages without one share a bucket.
+ * As a sender picks its response topic, a per-topic bucket shared by all senders caps the total
+ * on top: a sender changing its response topic on every message is still held to it.
+ * Priority messages (abort, disable) go through a reserved lane, buckets of their own, so a
+ * flood of normal messages never gets them dropped. The lane has a per-topic cap of its own
+ * (the topic cap, or one sender's limit without one), so flooding it gains nothing either.
+ * A message of a new sender over its topic cap is dropped without creating a bucket, senders
+ * made up on the fly never evict the buckets of real ones.
+ * Messages over the limit of their topic are either dropped or, for latest-value topics,
+ * coalesced: the newest one is held and delivered by release once its buckets refill.
+ * Topics without a limit are never checked. The number of sender buckets is bounded, idle ones
+ * are evicted first. Thread safe.
+ */
+class RateLimiter
+{
+    public:
+        enum class Policy {
+            Drop,
+            Coalesce
+        };
+
+        struct Limit
+        {
+            double rate = 0;                // Messages per second and sender, 0 disables the limit
+            int burst = 1;                  // Bucket size, messages accepted back to back
+            double topic_rate = 0;          // Messages per second of all senders together, 0 for no cap
+            int topic_burst = 1;
+            Policy policy = Policy::Drop;
+        };
+
+        enum class Decision {
+            Accept,
+            Drop,
+            Coalesced       // Held in place of the previous excess message, see release
+        };
+
+        /**
+         * Outcome of check for a rejected message
+         */
+        struct Rejection
+        {
+            bool notify = false;            // First rejection of the bucket since the last notice
+            bool topic_limit = false;       // Rejected by the bucket of all senders
+            uint64_t rejected = 0;          // Rejected by the bucket since the last notice
+            int retry_after_ms = 0;         // Until the bucket holds a token again
+        };
+
+        struct Held
+        {
+            std::string topic;
+            std::string payload;
+            RequestContext request;
+        };
+
+        struct Stats
+        {
+            size_t buckets = 0;
+            size_t held = 0;
+            uint64_t accepted = 0;
+            uint64_t priority = 0;          // Accepted on the reserved lane
+            uint64_t dropped = 0;
+            uint64_t topic_limited = 0;     // Rejected by the per-topic cap, not the sender's bucket
+            uint64_t coalesced = 0;         // Excess messages replaced by a newer one before release
+            uint64_t released = 0;
+            uint64_t evicted = 0;
+        };
+
+        /**
+         * @brief RateLimiter
+         * @param max_buckets           Sources and topics tracked at once
+         * @param notice_interval_ms    Minimum time between two rejection notices of a bucket
+         */
+        RateLimiter(size_t max_buckets = 256, int notice_interval_ms = 1000);
+
+        /**
+         * @brief setLimit  Resets the buckets of topic
+         */
+        void setLimit(const std::string &topic, const Limit &limit);
+        bool limited(const std::string &topic);
+        bool coalescing(void);
+
+        /**
+         * @brief check     Take a token from the buckets of source and topic
+         * @param priority  Reserved lane: sender buckets and a per-topic cap of its own, never coalesced
+         */
+        Decision check(const std::string &source, const std::string &topic, const std::string &payload,
+                       const RequestContext &request, bool priority, Rejection &rejection);
+
+        /**
+         * @brief release   Held messages whose buckets refilled, in bucket order
+         */
+        void release(std::vector<Held> &ready);
+
+        Stats stats(void);
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Bucket
+        {
+            double rate = 0;
+            int burst = 1;
+            Policy policy = Policy::Drop;
+            double tokens = 0;
+            Clock::time_point updated;
+            Clock::time_point seen;         // Last message
+            Clock::time_point last_notice;
+            uint64_t rejected = 0;          // Since the last notice
+            Bucket *shared = NULL;          // Per-topic cap, NULL for none
+            bool holding = false;
+            Held held;
+        };
+
+        std::mutex mtx_;
+        size_t max_buckets_;
+        std::chrono::milliseconds notice_interval_;
+        std::map<std::string, Limit> limits_;
+        std::map<std::string, Bucket> topic_buckets_;           // <topic>, <topic>\0 for priority. Never erased, sender buckets point to them
+        std::unordered_map<std::string, Bucket> buckets_;       // <source>\0<topic>, \0 appended for priority
+        size_t holding_ = 0;
+        Stats stats_;
+
+        Bucket makeBucket(double rate, int burst, Policy policy, Clock::time_point now);
+        static void refill(Bucket &bucket, Clock::time_point now);
+        static bool take(Bucket &bucket);
+        void notice(Bucket &limiting, Rejection &rejection, Clock::time_point now);
+        void evict(Clock::time_point now);
+};
+
+#endif // RATELIMITER_H
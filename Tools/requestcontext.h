@@ -0,0 +1,36 @@
+#ifndef REQUESTCONTEXT_H
+#define REQUESTCONTEXT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The RequestContext struct
+ * MQTT v5 request properties of an inbound command. Replies about the command are also sent to
+ * response_topic carrying the same correlation data, so a requester can pipeline commands and
+ * match the results. Empty for commands from the GUI or from v3 clients.
+ */
+struct RequestContext
+{
+    std::string response_topic;
+    std::string correlation_data;   // Opaque, binary
+    bool has_expiry = false;
+    std::chrono::steady_clock::time_point expires;
+
+    /**
+     * @brief setExpiry     Message expiry interval left when the broker delivered the command
+     */
+    void setExpiry(uint32_t interval_s)
+    {
+        has_expiry = true;
+        expires = std::chrono::steady_clock::now() + std::chrono::seconds(interval_s);
+    }
+
+    bool expired(void) const
+    {
+        return has_expiry && std::chrono::steady_clock::now() >= expires;
+    }
+};
+
+#endif // REQUESTCONTEXT_H
@@ -1,48 +1,444 @@
 #include "robotCommunication.h"
+#include <algorithm>
 
-RobotCommunication::RobotCommunication(boost::function<void (std::string)> callback, Console *console)
+RobotCommunication::RobotCommunication(CommandCallback callback, Console *console, FlightRecorder *recorder)
 {
     callback_ = callback;
     console_ = console;
-    cli = new mqtt::async_client(SERVER_ADDRESS, CLIENT_ID);
-    keep_alive_ = true;
+    recorder_ = recorder;
+    command_topic_ = ServerOptions().command_topic;
+    session_ = MqttSession::shared(console);
+    state_publisher_ = new StatePublisher(boost::bind(&RobotCommunication::publishState, this, _1, _2, _3));
 
-    // Connect MQTT Client
-    connect_client();
+    // Handlers that asked for the GUI thread are queued to this object's thread
+    qRegisterMetaType<RouterTask>("RouterTask");
+    connect(this, &RobotCommunication::routedToGui, this, &RobotCommunication::runRouterTask, Qt::QueuedConnection);
+    router_ = new TopicRouter([this](RouterTask task) { emit routedToGui(task); });
+    release_timer_ = new QTimer(this);
+    connect(release_timer_, &QTimer::timeout, this, &RobotCommunication::releaseHeld);
+    // Rejection notices while offline, the latest is enough
+    addCoalescedTopic(RATE_LIMITED_TOPIC);
 
-    /// Initialize Connection status checker
-    timer_ = new QTimer(this);
-    connect(timer_, &QTimer::timeout, this, &RobotCommunication::check_status);
-    timer_->start(1000);
+    connect(session_.get(), &MqttSession::readyChanged, this, &RobotCommunication::readyChanged);
+    connect(session_.get(), &MqttSession::readyChanged, this, &RobotCommunication::republishStates);
+    connect(session_.get(), &MqttSession::heartbeatUpdated, this, &RobotCommunication::heartbeatUpdated);
+}
+
+void RobotCommunication::setServerOptions(const ServerOptions &options)
+{
+    command_topic_ = options.command_topic;
+    robot_namespace_ = options.robot_namespace;
+    session_->setServerOptions(options);
+}
+
+void RobotCommunication::setLinkOptions(const LinkOptions &options)
+{
+    session_->setLinkOptions(options);
+}
+
+void RobotCommunication::setRobotName(const std::string &name)
+{
+    std::string name_space = robot_namespace_? name : std::string();
+    // A single topic level, never a wildcard
+    std::replace_if(name_space.begin(), name_space.end(), [](char c) { return c == '/' || c == '+' || c == '#'; }, '_');
+
+    std::string previous;
+    {
+        std::lock_guard<std::mutex> lck(namespace_mtx_);
+        if (name_space == namespace_)
+        {
+            return;
+        }
+        previous = namespace_;
+        namespace_ = name_space;
+        if (!started_)
+        {
+            return;
+        }
+    }
+
+    CONSOLE_INFO(console_, LogTag::Mqtt, "Mqtt topics moved from namespace '%s' to '%s'", previous.c_str(), name_space.c_str());
+    detach(previous);
+    attach(name_space);
+    publishPresence(name_space);
+    // Latest states, under the new namespace
+    state_publisher_->republish();
+}
+
+std::string RobotCommunication::topicNamespace()
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    return namespace_;
+}
+
+void RobotCommunication::setLastWill(const std::string &topic, const std::string &field, const std::string &value)
+{
+    will_topic_ = topic;
+    will_payload_ = payload_cache_.get(topic, field, value);
+}
+
+void RobotCommunication::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    // Commands are only parsed and queued, cheap enough for the paho thread
+    subscribe(command_topic_, QOS, boost::bind(&RobotCommunication::onCommand, this, _1, _2, _3), TopicRouter::Dispatch::Inline);
+
+    std::string name_space;
+    {
+        std::lock_guard<std::mutex> lck(namespace_mtx_);
+        started_ = true;
+        name_space = namespace_;
+        attach(name_space);
+        session_->start();
+        publishPresence(name_space);
+
+        // Published before start, now under the robot's namespace and in order
+        OutboundMessage msg;
+        while (pending_.pop(msg))
+        {
+            session_->enqueue(topic(name_space, msg.topic), msg.payload, msg.retained, "", durable_topics_.count(msg.topic) > 0,
+                              msg.content_type);
+        }
+    }
+    CONSOLE_INFO(console_, LogTag::Mqtt, "Mqtt client %s, robot namespace '%s', %zu robots in session",
+                 session_->clientId().c_str(), name_space.c_str(), session_->contextCount());
 }
 
 RobotCommunication::~RobotCommunication()
 {
-    keep_alive_ = false;
+    // Sends merged states still pending
+    delete state_publisher_;
     end_communication();
-    delete cli;
+    session_->leave(console_);
+    // Handlers still queued on the workers run first
+    delete router_;
+}
+
+std::string RobotCommunication::topic(const std::string &name_space, const std::string &local)
+{
+    return name_space.empty()? local : name_space + "/" + local;
+}
+
+void RobotCommunication::attach(const std::string &name_space)
+{
+    session_->attach(name_space, boost::bind(&RobotCommunication::receive, this, _1, _2, _3));
+    for (const auto &subscription : subscriptions_)
+    {
+        session_->addSubscription(topic(name_space, subscription.first), subscription.second);
+    }
+    for (const auto &coalesced : coalesced_topics_)
+    {
+        session_->addCoalescedTopic(topic(name_space, coalesced));
+    }
+}
+
+void RobotCommunication::detach(const std::string &name_space)
+{
+    session_->detach(name_space);
+    for (const auto &subscription : subscriptions_)
+    {
+        session_->removeSubscription(topic(name_space, subscription.first));
+    }
+}
+
+void RobotCommunication::publishPresence(const std::string &name_space)
+{
+    // The connection has a single will: dashboards follow this robot's liveness on the
+    // session's presence topic named here
+    const std::string &local = session_->linkOptions().presence_topic;
+    session_->enqueue(topic(name_space, local), payload_cache_.get(local, "presence_topic", session_->presenceTopic()), true);
+}
+
+void RobotCommunication::receive(const std::string &topic, const std::string &payload, const RequestContext &request)
+{
+    if (recorder_ != NULL)
+    {
+        recorder_->record(flight::kEventMqttIn, 0, topic);
+    }
+    // Before any parsing or queuing, a flood costs one bucket lookup per message
+    RateLimiter::Rejection rejection;
+    bool priority = topic == command_topic_ && priority_filter_ && rate_limiter_.limited(topic) && priority_filter_(payload);
+    RateLimiter::Decision decision = rate_limiter_.check(request.response_topic, topic, payload, request, priority, rejection);
+    if (decision != RateLimiter::Decision::Accept)
+    {
+        if (rejection.notify)
+        {
+            rejectInbound(topic, request, rejection, decision);
+        }
+        return;
+    }
+    if (!router_->route(topic, payload, request))
+    {
+        CONSOLE_DEBUG(console_, LogTag::Mqtt, "Mqtt message on %s not handled", topic.c_str());
+    }
+}
+
+void RobotCommunication::rejectInbound(const std::string &topic, const RequestContext &request, const RateLimiter::Rejection &rejection,
+                                       RateLimiter::Decision decision)
+{
+    const char *action = (decision == RateLimiter::Decision::Coalesced)? "coalesced" : "dropped";
+    CONSOLE_WARN(console_, LogTag::Mqtt, "Mqtt messages on %s from '%s' over the %s rate limit, %llu %s, retry after %d ms",
+                 topic.c_str(), request.response_topic.c_str(), rejection.topic_limit? "topic" : "sender",
+                 static_cast<unsigned long long>(rejection.rejected), action, rejection.retry_after_ms);
+
+    Json::Value message_json;
+    Json::FastWriter writer;
+    message_json["topic"] = topic;
+    message_json["rate_limited"] = true;
+    message_json["action"] = action;
+    message_json["limit"] = rejection.topic_limit? "topic" : "sender";
+    message_json["rejected"] = static_cast<Json::UInt64>(rejection.rejected);
+    message_json["retry_after_ms"] = rejection.retry_after_ms;
+    message_json["message"] = topic + ": rate limit exceeded";
+    publishReply(request, RATE_LIMITED_TOPIC, writer.write(message_json));
+}
+
+void RobotCommunication::setRateLimit(const std::string &topic, const RateLimiter::Limit &limit)
+{
+    rate_limiter_.setLimit(topic, limit);
+    if (rate_limiter_.coalescing())
+    {
+        release_timer_->start(RELEASE_INTERVAL_MS);
+    }
+    else
+    {
+        release_timer_->stop();
+    }
+}
+
+void RobotCommunication::setPriorityFilter(PriorityFilter filter)
+{
+    priority_filter_ = filter;
+}
+
+RateLimiter::Stats RobotCommunication::rateLimitStats()
+{
+    return rate_limiter_.stats();
+}
+
+void RobotCommunication::releaseHeld()
+{
+    // Coalesced messages whose bucket refilled, routed from the GUI thread
+    std::vector<RateLimiter::Held> ready;
+    rate_limiter_.release(ready);
+    for (const RateLimiter::Held &held : ready)
+    {
+        router_->route(held.topic, held.payload, held.request);
+    }
 }
 
 void RobotCommunication::publish(std::string topic, std::string msg)
 {
-    auto payload = mqtt::make_message(topic, msg);
-    payload->set_qos(QOS);
-    try{
-        cli->publish(payload);
+    enqueue(topic, std::make_shared<const std::string>(std::move(msg)), false);
+}
+
+void RobotCommunication::publishRetained(std::string topic, std::string msg)
+{
+    enqueue(topic, std::make_shared<const std::string>(std::move(msg)), true);
+}
+
+void RobotCommunication::publishState(const std::string &topic, const std::string &field, const std::string &value)
+{
+    enqueue(topic, payload_cache_.get(topic, field, value), true);
+}
+
+bool RobotCommunication::subscribe(const std::string &filter, int qos, TopicRouter::Handler handler, TopicRouter::Dispatch dispatch)
+{
+    if (!router_->subscribe(filter, handler, dispatch))
+    {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Invalid Mqtt topic filter '%s'", filter.c_str());
+        return false;
     }
-    catch(const mqtt::exception& exc){
-        console_->print("Error: Mqtt exception. Attempting reconnection!");
-        connect_client();
+    addBrokerSubscription(filter, qos);
+    return true;
+}
+
+bool RobotCommunication::subscribeJson(const std::string &filter, int qos, TopicRouter::JsonHandler handler, TopicRouter::Dispatch dispatch)
+{
+    if (!router_->subscribeJson(filter, handler, dispatch))
+    {
+        CONSOLE_ERROR(console_, LogTag::Mqtt, "Invalid Mqtt topic filter '%s'", filter.c_str());
+        return false;
+    }
+    addBrokerSubscription(filter, qos);
+    return true;
+}
+
+void RobotCommunication::addBrokerSubscription(const std::string &filter, int qos)
+{
+    // Subscribed on the broker when attached to the session, and again in a new namespace
+    subscriptions_.push_back(std::make_pair(filter, qos));
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    if (started_)
+    {
+        session_->addSubscription(topic(namespace_, filter), qos);
     }
+}
 
+TopicRouter::Stats RobotCommunication::routerStats()
+{
+    return router_->stats();
 }
 
-void RobotCommunication::publish(std::string topic, std::string field, bool value)
+void RobotCommunication::runRouterTask(RouterTask task)
 {
+    task();
+}
+
+void RobotCommunication::republishStates(bool ready)
+{
+    if (ready)
+    {
+        // Retained states may have been replaced by the will meanwhile, queued behind the buffer
+        state_publisher_->republish();
+    }
+}
+
+void RobotCommunication::onCommand(const std::string &topic, const std::string &payload, const RequestContext &request)
+{
+    Q_UNUSED(topic);
+    callback_(payload, request);
+}
+
+void RobotCommunication::publishReply(const RequestContext &request, std::string topic, std::string msg)
+{
+    Payload payload = std::make_shared<const std::string>(std::move(msg));
+    enqueue(topic, payload, false);
+    enqueueReply(request, payload, durable(topic));
+}
+
+void RobotCommunication::publishReply(const RequestContext &request, std::string topic, std::string field, bool value, std::string msg)
+{
+    if (msg.empty())
+    {
+        Payload payload = payload_cache_.get(topic, field, value);
+        enqueue(topic, payload, false);
+        enqueueReply(request, payload, durable(topic));
+        return;
+    }
+
     Json::Value message_json;
     Json::FastWriter writer;
     message_json[field] = value;
-    publish(topic, writer.write(message_json));
+    message_json["message"] = msg;
+    publishReply(request, topic, writer.write(message_json));
+}
+
+void RobotCommunication::enqueue(const std::string &topic, const Payload &payload, bool retained, const char *content_type)
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    std::string full_topic = RobotCommunication::topic(namespace_, topic);
+    if (recorder_ != NULL)
+    {
+        recorder_->record(flight::kEventMqttOut, 0, full_topic, static_cast<int32_t>(payload->size()), *payload);
+    }
+
+    if (!started_)
+    {
+        // Namespaced once started
+        OutboundMessage out;
+        out.topic = topic;
+        out.payload = payload;
+        out.retained = retained;
+        out.content_type = content_type;
+        pending_.push(out);
+        return;
+    }
+    session_->enqueue(full_topic, payload, retained, "", durable_topics_.count(topic) > 0, content_type);
+}
+
+void RobotCommunication::enqueueReply(const RequestContext &request, const Payload &payload, bool durable)
+{
+    // The requester's own topic, outside the namespace
+    if (request.response_topic.empty())
+    {
+        return;
+    }
+    if (recorder_ != NULL)
+    {
+        recorder_->record(flight::kEventMqttOut, 0, request.response_topic, static_cast<int32_t>(payload->size()), *payload);
+    }
+    session_->enqueue(request.response_topic, payload, false, request.correlation_data, durable);
+}
+
+void RobotCommunication::addCoalescedTopic(const std::string &topic)
+{
+    coalesced_topics_.push_back(topic);
+    pending_.addCoalescedTopic(topic);
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    if (started_)
+    {
+        session_->addCoalescedTopic(RobotCommunication::topic(namespace_, topic));
+    }
+}
+
+void RobotCommunication::addStateTopic(const std::string &topic)
+{
+    addCoalescedTopic(topic);
+    state_publisher_->addTopic(topic);
+}
+
+void RobotCommunication::addDurableTopic(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    durable_topics_.insert(topic);
+}
+
+void RobotCommunication::setTopicEncoding(const std::string &topic, PayloadWriter::Format format)
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    encodings_[topic] = format;
+}
+
+PayloadWriter::Format RobotCommunication::topicEncoding(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    auto it = encodings_.find(topic);
+    return (it != encodings_.end())? it->second : PayloadWriter::Format::Json;
+}
+
+bool RobotCommunication::durable(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(namespace_mtx_);
+    return durable_topics_.count(topic) > 0;
+}
+
+void RobotCommunication::setOutboundCapacity(size_t capacity)
+{
+    session_->setOutboundCapacity(capacity);
+}
+
+size_t RobotCommunication::outboundDepth()
+{
+    return session_->outboundDepth();
+}
+
+uint64_t RobotCommunication::outboundDroppedCount() const
+{
+    return session_->outboundDroppedCount();
+}
+
+uint64_t RobotCommunication::outboundCoalescedCount() const
+{
+    return session_->outboundCoalescedCount();
+}
+
+uint64_t RobotCommunication::stateSuppressedCount() const
+{
+    return state_publisher_->suppressedCount();
+}
+
+uint64_t RobotCommunication::stateMergedCount() const
+{
+    return state_publisher_->mergedCount();
+}
+
+void RobotCommunication::publish(std::string topic, std::string field, bool value)
+{
+    enqueue(topic, payload_cache_.get(topic, field, value), false);
 }
 
 void RobotCommunication::publish(std::string topic, std::string field, bool value, std::string msg)
@@ -56,84 +452,76 @@ void RobotCommunication::publish(std::string topic, std::string field, bool valu
 
 void RobotCommunication::publish(std::string topic, std::string field, std::string value)
 {
-    Json::Value message_json;
-    Json::FastWriter writer;
-    message_json[field] = value;
-    publish(topic, writer.write(message_json));
+    if (state_publisher_->handles(topic))
+    {
+        state_publisher_->publish(topic, field, value);
+        return;
+    }
+    enqueue(topic, payload_cache_.get(topic, field, value), false);
 }
 
-void RobotCommunication::end_communication()
+Heartbeat::Stats RobotCommunication::heartbeatStats()
 {
-    keep_alive_ = false;
-    try {
-        // Disconnect MQTT
+    return session_->heartbeatStats();
+}
 
-        // Shutting down and disconnecting from the MQTT server
-        cli->unsubscribe(TOPIC);
-        cli->stop_consuming();
-        cli->disconnect();
-    }
-    catch (const mqtt::exception& exc) {
-        std::cerr << exc.what() << std::endl;
-    }
+DeliveryTracker::Stats RobotCommunication::deliveryStats()
+{
+    return session_->deliveryStats();
 }
 
-void RobotCommunication::connect_client()
+OutboundJournal::Stats RobotCommunication::journalStats()
 {
-    connOpts.set_keep_alive_interval(36000);
-    connOpts.set_clean_session(true);
+    return session_->journalStats();
+}
 
-    try {
-        //cli->set_connected_handler([this](const std::string& cause){connected_cb(cause);});
-        cli->connect(connOpts)->wait();
-        cli->set_message_callback([this](mqtt::const_message_ptr msg) {callback_(msg->get_payload_str());});
-        console_->print("Connected to Mqtt Server: " + SERVER_ADDRESS + ". Client: " + CLIENT_ID);
-        cli->subscribe(TOPIC, QOS)->wait();
-        console_->print("Subscribed to topic: " + TOPIC);
+size_t RobotCommunication::sessionRobotCount()
+{
+    return session_->contextCount();
+}
 
-    }
-    catch (const mqtt::exception& exc) {
-        std::cerr << exc.what() << std::endl;
-    }
+uint64_t RobotCommunication::sessionUnroutedCount() const
+{
+    return session_->unroutedCount();
 }
 
-void RobotCommunication::reconnect_client()
+bool RobotCommunication::isReady() const
 {
-    try {
-        cli->reconnect();
-    }
-    catch (const mqtt::exception& exc) {
-        std::cerr << exc.what() << std::endl;
-    }
+    return session_->isReady();
 }
 
-void RobotCommunication::connected_cb(const std::string& cause)
+MqttConnection::State RobotCommunication::connectionState() const
 {
-    Q_UNUSED(cause);
-//    console_->print("Connected to Mqtt Server: " + SERVER_ADDRESS + ". Client: " + CLIENT_ID);
-//    cli->subscribe(TOPIC, QOS);
-//    console_->print("Subscribed to topic: " + TOPIC);
+    return session_->connectionState();
 }
 
-void RobotCommunication::disconnected_cb(const mqtt::properties &properties, mqtt::ReasonCode cause)
+std::string RobotCommunication::currentServer() const
 {
-    Q_UNUSED(properties);
-    Q_UNUSED(cause);
+    return session_->currentServer();
+}
 
-    console_->print("Warning: Mqtt disconnected. Reconnecting now...");
-    if (keep_alive_)
-    {
-        cli->connect(connOpts);
-    }
+const std::string &RobotCommunication::clientId() const
+{
+    return session_->clientId();
 }
 
-void RobotCommunication::check_status(void)
+void RobotCommunication::end_communication()
 {
-    //publish("robot_heartbeat", "alive");
-    //std::cout << cli->is_connected() << std::endl;
-    if (!cli->is_connected())
+    std::string name_space;
+    {
+        std::lock_guard<std::mutex> lck(namespace_mtx_);
+        if (!started_)
+        {
+            return;
+        }
+        started_ = false;
+        name_space = namespace_;
+    }
+    // A clean disconnect does not trigger the will, publish it ourselves. Sent by the session
+    // even after this robot left, as long as another one keeps it connected.
+    if (will_payload_)
     {
-        console_->print("Error: WiFi Network Reconnection Detected. Attempting MQTT reconnection!");
-        connect_client();
+        session_->enqueue(topic(name_space, will_topic_), will_payload_, true);
     }
+    detach(name_space);
 }
@@ -6,43 +6,241 @@
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <Tools/console.h>
+#include <Tools/flightrecorder.h>
+#include <Tools/mqttsession.h>
+#include <Tools/outboundbuffer.h>
+#include <Tools/statepublisher.h>
+#include <Tools/payloadcache.h>
+#include <Tools/heartbeat.h>
+#include <Tools/deliverytracker.h>
+#include <Tools/requestcontext.h>
+#include <Tools/topicrouter.h>
+#include <Tools/payloadwriter.h>
+#include <Tools/ratelimiter.h>
 #include <jsoncpp/json/json.h>
 #include <QTimer>
+#include <map>
+#include <set>
 
+// Handler call posted to the GUI thread by the TopicRouter
+typedef boost::function<void (void)> RouterTask;
+Q_DECLARE_METATYPE(RouterTask)
+
+/**
+ * @brief The RobotCommunication class
+ * MQTT link of one robot. Robots of the process share a single MqttSession; the topics of each
+ * are prefixed with its name (<robot name>/robot_status), so the session hands a robot only its
+ * own messages.
+ */
 class RobotCommunication : public QObject
 {
     Q_OBJECT
 
     public:
-        RobotCommunication(boost::function<void (std::string)> callback, Console *console);
+        typedef MqttSession::ServerOptions ServerOptions;
+        typedef MqttSession::LinkOptions LinkOptions;
+        typedef boost::function<void (std::string, const RequestContext &)> CommandCallback;
+        typedef boost::function<bool (const std::string &payload)> PriorityFilter;
+
+        /**
+         * @brief RobotCommunication    Robot context of the shared MQTT v5 session
+         * @param callback              Inbound commands with their request properties, on the paho thread
+         */
+        RobotCommunication(CommandCallback callback, Console *console, FlightRecorder *recorder = NULL);
         ~RobotCommunication();
 
+        /**
+         * @brief start     Join the session, starting it for the first robot, after the server and
+         *                  link options, will and robot name are set. Never blocks. Messages
+         *                  published before are buffered.
+         */
+        void start(void);
+        void setServerOptions(const ServerOptions &options);
+        void setLinkOptions(const LinkOptions &options);
+
+        /**
+         * @brief setRobotName  Topic namespace of this robot. Subscriptions move to the new
+         *                      namespace and states are published again there.
+         */
+        void setRobotName(const std::string &name);
+        std::string topicNamespace(void);
+
+        /**
+         * @brief setLastWill   Retained {"<field>": "<value>"} published on topic by
+         *                      end_communication on shutdown. A lost connection is reported for
+         *                      all robots of the session at once, by the will on the session's
+         *                      presence topic, which each robot names on <namespace>/<presence_topic>.
+         */
+        void setLastWill(const std::string &topic, const std::string &field, const std::string &value);
+
         void end_communication();
         void publish(std::string topic, std::string msg);
         void publish(std::string topic, std::string field, bool value);
         void publish(std::string topic, std::string field, bool value, std::string msg);
         void publish(std::string topic, std::string field, std::string value);
 
+        /**
+         * @brief subscribe     Route messages matching filter (+ and # wildcards allowed, within
+         *                      the robot's namespace) to handler, run inline on the paho thread, on
+         *                      the router's worker pool or on the GUI thread. Subscribed on the
+         *                      broker right away when connected, otherwise with the next connect.
+         * @return false if filter is invalid
+         */
+        bool subscribe(const std::string &filter, int qos, TopicRouter::Handler handler, TopicRouter::Dispatch dispatch);
+        bool subscribeJson(const std::string &filter, int qos, TopicRouter::JsonHandler handler, TopicRouter::Dispatch dispatch);
+        TopicRouter::Stats routerStats(void);
+
+        /**
+         * @brief publishReply  Publish on topic and, if the request carries a response topic,
+         *                      send the same payload there with the request's correlation data
+         */
+        void publishReply(const RequestContext &request, std::string topic, std::string msg);
+        void publishReply(const RequestContext &request, std::string topic, std::string field, bool value, std::string msg = "");
+
+        /**
+         * @brief publishRetained   Broker keeps the message and hands it to late subscribers
+         */
+        void publishRetained(std::string topic, std::string msg);
+
+        /**
+         * @brief publishEncoded    Telemetry publish: build(PayloadWriter &) writes the fields into
+         *                          a pooled buffer, in the topic's encoding (JSON unless set with
+         *                          setTopicEncoding), announced by the MQTT v5 content type
+         */
+        template <typename Builder>
+        void publishEncoded(const std::string &topic, Builder build)
+        {
+            PayloadWriter::Format format = topicEncoding(topic);
+            std::shared_ptr<std::string> buffer = payload_pool_.acquire();
+            PayloadWriter writer(*buffer, format);
+            build(writer);
+            enqueue(topic, buffer, false, PayloadWriter::contentType(format));
+        }
+
+        void setTopicEncoding(const std::string &topic, PayloadWriter::Format format);
+        PayloadWriter::Format topicEncoding(const std::string &topic);
+
+        /**
+         * @brief setRateLimit  Token bucket per source and topic for inbound messages of topic,
+         *                      checked before routing. Senders over the limit are told on
+         *                      robot_rate_limited and on their response topic, at most once a
+         *                      second. See RateLimiter. Call from the GUI thread.
+         */
+        void setRateLimit(const std::string &topic, const RateLimiter::Limit &limit);
+
+        /**
+         * @brief setPriorityFilter     Commands for which filter returns true (abort, disable) go
+         *                              through the rate limiter's reserved lane. Called on the
+         *                              paho thread, for rate limited commands only.
+         */
+        void setPriorityFilter(PriorityFilter filter);
+        RateLimiter::Stats rateLimitStats(void);
+
+        /**
+         * @brief isReady   Connected and subscribed. Never blocks.
+         */
+        bool isReady(void) const;
+        MqttConnection::State connectionState(void) const;
+        std::string currentServer(void) const;
+        const std::string &clientId(void) const;
+
+        /**
+         * @brief addCoalescedTopic  While offline, keep only the latest message of topic
+         */
+        void addCoalescedTopic(const std::string &topic);
+
+        /**
+         * @brief addStateTopic      Latest-value topic: field publishes go through the StatePublisher
+         *                           (identical values suppressed, rapid changes merged, retained)
+         *                           and are coalesced while offline
+         */
+        void addStateTopic(const std::string &topic);
+
+        /**
+         * @brief addDurableTopic    Messages of topic (and replies sent with them) are journaled on
+         *                           disk until the broker acknowledges them, see OutboundJournal
+         */
+        void addDurableTopic(const std::string &topic);
+        void setOutboundCapacity(size_t capacity);
+
+        // Offline buffer statistics, of the whole session
+        size_t outboundDepth(void);
+        uint64_t outboundDroppedCount(void) const;
+        uint64_t outboundCoalescedCount(void) const;
+
+        // State publisher statistics
+        uint64_t stateSuppressedCount(void) const;
+        uint64_t stateMergedCount(void) const;
+
+        // Heartbeat round trip statistics
+        Heartbeat::Stats heartbeatStats(void);
+
+        // Publish to PUBACK latency, in-flight window and delivery failures
+        DeliveryTracker::Stats deliveryStats(void);
+
+        // Durable messages waiting for their acknowledgement on disk
+        OutboundJournal::Stats journalStats(void);
+
+        // Robots sharing the session, and inbound messages none of them claimed
+        size_t sessionRobotCount(void);
+        uint64_t sessionUnroutedCount(void) const;
+
+    signals:
+        void readyChanged(bool ready);
+        void heartbeatUpdated(void);
+        void routedToGui(RouterTask task);
+
+    private slots:
+        void republishStates(bool ready);
+        void runRouterTask(RouterTask task);
+        void releaseHeld(void);
+
     private:
-        //const std::string SERVER_ADDRESS	{ "tcp://192.168.5.128:1883" };
-        const std::string SERVER_ADDRESS	{ "localhost:1883" };
-        const std::string CLIENT_ID         { "robot" };
-        const std::string TOPIC 			{ "robot_depart" };
         const int  QOS = 1;
-        bool keep_alive_ = true;
+        const std::string RATE_LIMITED_TOPIC { "robot_rate_limited" };
+        const int RELEASE_INTERVAL_MS = 50;
+
+        std::shared_ptr<MqttSession> session_;
+        std::mutex namespace_mtx_;
+        bool started_ = false;
+        std::string command_topic_;
+        bool robot_namespace_ = true;
+        std::string namespace_;
+        std::string will_topic_;
+        Payload will_payload_;
 
-        mqtt::connect_options connOpts;
-        mqtt::async_client* cli;
+        // Messages published before start, while the namespace may still change
+        OutboundBuffer pending_;
+        std::vector<std::string> coalesced_topics_;
+        std::set<std::string> durable_topics_;
+        std::map<std::string, PayloadWriter::Format> encodings_;
+        PayloadPool payload_pool_;
+        StatePublisher *state_publisher_;
+        PayloadCache payload_cache_;
 
-        boost::function<void (std::string)> callback_;
+        // Inbound messages by topic filter, relative to the namespace
+        TopicRouter *router_;
+        RateLimiter rate_limiter_;
+        PriorityFilter priority_filter_;
+        QTimer *release_timer_;
+        std::vector<std::pair<std::string, int>> subscriptions_;
+        CommandCallback callback_;
         Console *console_;
-        QTimer *timer_;
+        FlightRecorder *recorder_;
 
-        void connected_cb(const std::string& cause);
-        void disconnected_cb(const mqtt::properties &properties, mqtt::ReasonCode cause);
-        void connect_client();
-        void reconnect_client();
-        void check_status(void);
+        static std::string topic(const std::string &name_space, const std::string &local);
+        void attach(const std::string &name_space);
+        void detach(const std::string &name_space);
+        void publishPresence(const std::string &name_space);
+        void receive(const std::string &topic, const std::string &payload, const RequestContext &request);
+        void rejectInbound(const std::string &topic, const RequestContext &request, const RateLimiter::Rejection &rejection,
+                           RateLimiter::Decision decision);
+        void publishState(const std::string &topic, const std::string &field, const std::string &value);
+        void enqueue(const std::string &topic, const Payload &payload, bool retained, const char *content_type = NULL);
+        void enqueueReply(const RequestContext &request, const Payload &payload, bool durable);
+        bool durable(const std::string &topic);
+        void addBrokerSubscription(const std::string &filter, int qos);
+        void onCommand(const std::string &topic, const std::string &payload, const RequestContext &request);
 };
 
 #endif // ROBOTCOMMUNICATION_H
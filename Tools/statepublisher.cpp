@@ -0,0 +1,188 @@
+#include "statepublisher.h"
+#include "crashhandler.h"
+
+StatePublisher::StatePublisher(SendFunction send, int merge_window_ms)
+{
+    send_ = send;
+    merge_window_ = std::chrono::milliseconds(merge_window_ms);
+    published_ = 0;
+    suppressed_ = 0;
+    merged_ = 0;
+
+    flush_thread_ = new std::thread(&StatePublisher::run, this);
+}
+
+StatePublisher::~StatePublisher()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    // Merged values still pending are sent before exiting
+    flush_thread_->join();
+    delete flush_thread_;
+}
+
+void StatePublisher::addTopic(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    topics_.insert(topic);
+}
+
+bool StatePublisher::handles(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    return topics_.count(topic) > 0;
+}
+
+void StatePublisher::setMergeWindow(int merge_window_ms)
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    merge_window_ = std::chrono::milliseconds(merge_window_ms);
+}
+
+void StatePublisher::publish(const std::string &topic, const std::string &field, const std::string &value)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        std::string key = topic;
+        key.push_back('\0');
+        key.append(field);
+        Entry &entry = entries_[key];
+        if (entry.topic.empty())
+        {
+            entry.topic = topic;
+            entry.field = field;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (entry.has_pending)
+        {
+            if (value == entry.pending)
+            {
+                suppressed_++;
+            }
+            else if (entry.has_sent && value == entry.sent)
+            {
+                // Changed back within the window, nothing to send
+                entry.has_pending = false;
+                merged_++;
+            }
+            else
+            {
+                entry.pending = value;
+                merged_++;
+            }
+        }
+        else if (entry.has_sent && value == entry.sent)
+        {
+            suppressed_++;
+        }
+        else if (now >= entry.window_end)
+        {
+            send(entry, value, now);
+        }
+        else
+        {
+            // Window still open, the flush thread sends the latest value when it closes
+            entry.pending = value;
+            entry.has_pending = true;
+            wake = true;
+        }
+    }
+    if (wake)
+    {
+        cond_.notify_one();
+    }
+}
+
+void StatePublisher::invalidate()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    for (auto &it : entries_)
+    {
+        it.second.has_sent = false;
+    }
+}
+
+void StatePublisher::republish()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    for (auto &it : entries_)
+    {
+        Entry &entry = it.second;
+        if (entry.has_sent && !entry.has_pending)
+        {
+            send_(entry.topic, entry.field, entry.sent);
+        }
+    }
+}
+
+uint64_t StatePublisher::publishedCount() const
+{
+    return published_;
+}
+
+uint64_t StatePublisher::suppressedCount() const
+{
+    return suppressed_;
+}
+
+uint64_t StatePublisher::mergedCount() const
+{
+    return merged_;
+}
+
+void StatePublisher::send(Entry &entry, const std::string &value, std::chrono::steady_clock::time_point now)
+{
+    send_(entry.topic, entry.field, value);
+
+    entry.sent = value;
+    entry.has_sent = true;
+    entry.has_pending = false;
+    entry.window_end = now + merge_window_;
+    published_++;
+}
+
+void StatePublisher::run()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto next = std::chrono::steady_clock::time_point::max();
+        for (auto &it : entries_)
+        {
+            Entry &entry = it.second;
+            if (!entry.has_pending)
+            {
+                continue;
+            }
+            if (!running_ || now >= entry.window_end)
+            {
+                send(entry, entry.pending, now);
+            }
+            else if (entry.window_end < next)
+            {
+                next = entry.window_end;
+            }
+        }
+
+        if (!running_)
+        {
+            break;
+        }
+        if (next == std::chrono::steady_clock::time_point::max())
+        {
+            cond_.wait(lck);
+        }
+        else
+        {
+            cond_.wait_until(lck, next);
+        }
+    }
+}
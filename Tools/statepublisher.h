@@ -0,0 +1,85 @@
+#ifndef STATEPUBLISHER_H
+#define STATEPUBLISHER_H
+
+#include <boost/function.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/**
+ * @brief The StatePublisher class
+ * Latest-value publisher for state topics (robot_status, robot_location). Tracks the last value
+ * sent per topic/field and suppresses identical re-publishes. A change is sent right away,
+ * further changes within the merge window are merged and only the last one is sent when the
+ * window closes. Values are handed to the send callback, which publishes them retained.
+ */
+class StatePublisher
+{
+    public:
+        typedef boost::function<void (const std::string &topic, const std::string &field, const std::string &value)> SendFunction;
+
+        /**
+         * @brief StatePublisher
+         * @param send              Publishes {"<field>": "<value>"} retained
+         * @param merge_window_ms   Minimum time between two messages for the same topic/field
+         */
+        StatePublisher(SendFunction send, int merge_window_ms = 200);
+        ~StatePublisher();
+
+        void addTopic(const std::string &topic);
+        bool handles(const std::string &topic);
+        void setMergeWindow(int merge_window_ms);
+
+        void publish(const std::string &topic, const std::string &field, const std::string &value);
+
+        /**
+         * @brief invalidate    Forget the sent values, the next publish of every state is sent
+         */
+        void invalidate(void);
+
+        /**
+         * @brief republish     Send the last value of every state again, after a reconnect
+         */
+        void republish(void);
+
+        uint64_t publishedCount(void) const;
+        uint64_t suppressedCount(void) const;
+        uint64_t mergedCount(void) const;
+
+    private:
+        struct Entry
+        {
+            std::string topic;
+            std::string field;
+            std::string sent;
+            bool has_sent = false;
+            std::string pending;
+            bool has_pending = false;
+            std::chrono::steady_clock::time_point window_end;
+        };
+
+        SendFunction send_;
+        std::chrono::milliseconds merge_window_;
+
+        std::mutex mtx_;
+        std::condition_variable cond_;
+        std::set<std::string> topics_;
+        std::map<std::string, Entry> entries_;     // Key: topic + '\0' + field
+        bool running_ = true;
+
+        std::atomic<uint64_t> published_;
+        std::atomic<uint64_t> suppressed_;
+        std::atomic<uint64_t> merged_;
+
+        std::thread *flush_thread_ = NULL;
+
+        void run(void);
+        void send(Entry &entry, const std::string &value, std::chrono::steady_clock::time_point now);
+};
+
+#endif // STATEPUBLISHER_H
@@ -0,0 +1,258 @@
+#include "topicrouter.h"
+#include "crashhandler.h"
+#include <algorithm>
+#include <boost/bind.hpp>
+
+namespace
+{
+    const std::string SINGLE_LEVEL = "+";
+    const std::string MULTI_LEVEL = "#";
+}
+
+TopicRouter::TopicRouter(GuiPost gui_post, int workers)
+{
+    gui_post_ = gui_post;
+    invalid_json_ = 0;
+    for (int i = 0; i < std::max(workers, 1); i++)
+    {
+        workers_.push_back(new std::thread(&TopicRouter::workerRun, this));
+    }
+}
+
+TopicRouter::~TopicRouter()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    // Messages already queued are still handled
+    for (std::thread *worker : workers_)
+    {
+        worker->join();
+        delete worker;
+    }
+}
+
+bool TopicRouter::subscribe(const std::string &filter, Handler handler, Dispatch dispatch)
+{
+    if (!validFilter(filter) || (dispatch == Dispatch::Gui && !gui_post_))
+    {
+        return false;
+    }
+
+    std::shared_ptr<Subscription> subscription = std::make_shared<Subscription>();
+    subscription->handler = handler;
+    subscription->dispatch = dispatch;
+
+    std::lock_guard<std::mutex> lck(mtx_);
+    Node *node = &root_;
+    for (const std::string &level : split(filter))
+    {
+        std::unique_ptr<Node> &child = node->children[level];
+        if (!child)
+        {
+            child.reset(new Node());
+        }
+        node = child.get();
+    }
+    node->subscriptions.push_back(subscription);
+    return true;
+}
+
+bool TopicRouter::subscribeJson(const std::string &filter, JsonHandler handler, Dispatch dispatch)
+{
+    return subscribe(filter, boost::bind(&TopicRouter::parseJson, handler, &invalid_json_, _1, _2, _3), dispatch);
+}
+
+bool TopicRouter::route(const std::string &topic, const std::string &payload, const RequestContext &request)
+{
+    std::vector<std::string> levels = split(topic);
+    std::vector<std::shared_ptr<Subscription>> matches;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lck(mtx_);
+        match(root_, levels, 0, !topic.empty() && topic[0] == '$', matches);
+        if (matches.empty())
+        {
+            stats_.unmatched++;
+            return false;
+        }
+        stats_.routed++;
+
+        for (const std::shared_ptr<Subscription> &subscription : matches)
+        {
+            if (subscription->dispatch != Dispatch::Worker)
+            {
+                continue;
+            }
+            Message msg;
+            msg.topic = topic;
+            msg.payload = payload;
+            msg.request = request;
+            subscription->pending.push_back(std::move(msg));
+            if (!subscription->scheduled)
+            {
+                subscription->scheduled = true;
+                ready_.push_back(subscription);
+            }
+            stats_.worker_backlog++;
+            stats_.max_worker_backlog = std::max(stats_.max_worker_backlog, stats_.worker_backlog);
+            queued = true;
+        }
+    }
+    if (queued)
+    {
+        cond_.notify_one();
+    }
+
+    for (const std::shared_ptr<Subscription> &subscription : matches)
+    {
+        if (subscription->dispatch == Dispatch::Inline)
+        {
+            subscription->handler(topic, payload, request);
+        }
+        else if (subscription->dispatch == Dispatch::Gui)
+        {
+            gui_post_(boost::bind(subscription->handler, topic, payload, request));
+        }
+    }
+    return true;
+}
+
+TopicRouter::Stats TopicRouter::stats()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    Stats stats = stats_;
+    stats.invalid_json = invalid_json_;
+    return stats;
+}
+
+bool TopicRouter::validFilter(const std::string &filter)
+{
+    if (filter.empty())
+    {
+        return false;
+    }
+    std::vector<std::string> levels = split(filter);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        const std::string &level = levels[i];
+        if (level == MULTI_LEVEL)
+        {
+            if (i + 1 != levels.size())
+            {
+                return false;
+            }
+        }
+        else if (level != SINGLE_LEVEL && level.find_first_of("+#") != std::string::npos)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TopicRouter::match(const Node &node, const std::vector<std::string> &levels, size_t level, bool system_topic,
+                        std::vector<std::shared_ptr<Subscription>> &matches) const
+{
+    // Wildcards at the first level do not match $SYS style topics
+    bool wildcards = !(level == 0 && system_topic);
+
+    if (wildcards)
+    {
+        // "a/#" also matches "a"
+        auto multi = node.children.find(MULTI_LEVEL);
+        if (multi != node.children.end())
+        {
+            matches.insert(matches.end(), multi->second->subscriptions.begin(), multi->second->subscriptions.end());
+        }
+    }
+    if (level == levels.size())
+    {
+        matches.insert(matches.end(), node.subscriptions.begin(), node.subscriptions.end());
+        return;
+    }
+
+    auto exact = node.children.find(levels[level]);
+    if (exact != node.children.end())
+    {
+        match(*exact->second, levels, level + 1, system_topic, matches);
+    }
+    if (wildcards)
+    {
+        auto single = node.children.find(SINGLE_LEVEL);
+        if (single != node.children.end())
+        {
+            match(*single->second, levels, level + 1, system_topic, matches);
+        }
+    }
+}
+
+void TopicRouter::workerRun()
+{
+    CrashHandler::ThreadStack alternate_stack;
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (true)
+    {
+        while (running_ && ready_.empty())
+        {
+            cond_.wait(lck);
+        }
+        if (ready_.empty())
+        {
+            break;
+        }
+
+        // One message per turn, a busy subscription does not starve the others
+        std::shared_ptr<Subscription> subscription = ready_.front();
+        ready_.pop_front();
+        Message msg = std::move(subscription->pending.front());
+        subscription->pending.pop_front();
+
+        lck.unlock();
+        subscription->handler(msg.topic, msg.payload, msg.request);
+        lck.lock();
+
+        stats_.worker_backlog--;
+        if (subscription->pending.empty())
+        {
+            subscription->scheduled = false;
+        }
+        else
+        {
+            ready_.push_back(subscription);
+            cond_.notify_one();
+        }
+    }
+}
+
+std::vector<std::string> TopicRouter::split(const std::string &topic)
+{
+    std::vector<std::string> levels;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = topic.find('/', start);
+        levels.push_back(topic.substr(start, end - start));
+        if (end == std::string::npos)
+        {
+            return levels;
+        }
+        start = end + 1;
+    }
+}
+
+void TopicRouter::parseJson(const JsonHandler &handler, std::atomic<uint64_t> *invalid,
+                            const std::string &topic, const std::string &payload, const RequestContext &request)
+{
+    Json::Value message;
+    Json::Reader reader;
+    if (!reader.parse(payload, message))
+    {
+        (*invalid)++;
+        return;
+    }
+    handler(topic, message, request);
+}
@@ -0,0 +1,131 @@
+#ifndef TOPICROUTER_H
+#define TOPICROUTER_H
+
+#include <jsoncpp/json/json.h>
+#include <boost/function.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "requestcontext.h"
+
+/**
+ * @brief The TopicRouter class
+ * Subscription registry for inbound MQTT messages. Topic filters, including the + and #
+ * wildcards, are compiled into a trie of topic levels, so routing a message costs one walk over
+ * its levels whatever the number of subscriptions. Each subscription picks where its handler
+ * runs:
+ *  - Inline: on the delivering (paho) thread, for handlers that only hand the message on
+ *  - Worker: on a small thread pool. Messages of one subscription stay in order, a slow
+ *            handler only delays its own messages
+ *  - Gui:    posted to the GUI thread through the function given to the constructor
+ * Thread safe.
+ */
+class TopicRouter
+{
+    public:
+        enum class Dispatch {
+            Inline,
+            Worker,
+            Gui
+        };
+
+        typedef boost::function<void (const std::string &topic, const std::string &payload, const RequestContext &request)> Handler;
+        typedef boost::function<void (const std::string &topic, const Json::Value &message, const RequestContext &request)> JsonHandler;
+        typedef boost::function<void (boost::function<void (void)>)> GuiPost;
+
+        struct Stats
+        {
+            uint64_t routed = 0;
+            uint64_t unmatched = 0;
+            uint64_t invalid_json = 0;
+            size_t worker_backlog = 0;
+            size_t max_worker_backlog = 0;
+        };
+
+        /**
+         * @brief TopicRouter
+         * @param gui_post      Runs a function on the GUI thread, required for Dispatch::Gui
+         * @param workers       Worker pool size
+         */
+        TopicRouter(GuiPost gui_post, int workers = 2);
+        ~TopicRouter();
+
+        /**
+         * @brief subscribe     Route messages matching filter to handler
+         * @return false if filter is not a valid topic filter
+         */
+        bool subscribe(const std::string &filter, Handler handler, Dispatch dispatch);
+
+        /**
+         * @brief subscribeJson Same, the payload is parsed on the handler's thread. Payloads that
+         *                      are not JSON are counted and dropped.
+         */
+        bool subscribeJson(const std::string &filter, JsonHandler handler, Dispatch dispatch);
+
+        /**
+         * @brief route     Dispatch a received message to every matching subscription
+         * @return false if no subscription matches
+         */
+        bool route(const std::string &topic, const std::string &payload, const RequestContext &request);
+
+        Stats stats(void);
+
+        /**
+         * @brief validFilter   Wildcards only as whole levels, # only as the last level
+         */
+        static bool validFilter(const std::string &filter);
+
+    private:
+        struct Message
+        {
+            std::string topic;
+            std::string payload;
+            RequestContext request;
+        };
+
+        struct Subscription
+        {
+            Handler handler;
+            Dispatch dispatch;
+            // Worker strand: pending messages, and whether a worker owns the subscription
+            std::deque<Message> pending;
+            bool scheduled = false;
+        };
+
+        struct Node
+        {
+            std::map<std::string, std::unique_ptr<Node>> children;  // Includes the "+" and "#" levels
+            std::vector<std::shared_ptr<Subscription>> subscriptions;
+        };
+
+        GuiPost gui_post_;
+
+        std::mutex mtx_;
+        Node root_;
+        Stats stats_;
+        std::atomic<uint64_t> invalid_json_;
+
+        // Worker pool
+        std::condition_variable cond_;
+        std::deque<std::shared_ptr<Subscription>> ready_;
+        std::vector<std::thread *> workers_;
+        bool running_ = true;
+
+        // Called with mtx_ held
+        void match(const Node &node, const std::vector<std::string> &levels, size_t level, bool system_topic,
+                   std::vector<std::shared_ptr<Subscription>> &matches) const;
+
+        void workerRun(void);
+        static std::vector<std::string> split(const std::string &topic);
+        static void parseJson(const JsonHandler &handler, std::atomic<uint64_t> *invalid,
+                              const std::string &topic, const std::string &payload, const RequestContext &request);
+};
+
+#endif // TOPICROUTER_H
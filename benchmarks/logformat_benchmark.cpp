@@ -0,0 +1,89 @@
+/**
+ * Compares the original Console log line path against the LogQueue / LogFormatter path.
+ *
+ *  Caller side:  std::string concatenation + QString conversion   vs  vsnprintf into a ring slot
+ *  File side:    QDateTime::toString + QTextStream per line       vs  cached prefix into a reused buffer
+ */
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QString>
+#include <QByteArray>
+#include <QBuffer>
+#include <QTextStream>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include "Tools/logformat.h"
+#include "Tools/logqueue.h"
+
+static const int ITERATIONS = 200000;
+
+template <typename F>
+static double run(const char *name, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        func(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+    printf("%-48s %10.1f ns/line\n", name, ns);
+    return ns;
+}
+
+static bool vpush(LogQueue &queue, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    bool ok = queue.vpush(LogLevel::Info, LogTag::Mission, format, args);
+    va_end(args);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const QString filename = "/home/sharp/missions/toBeds/LF_hallway_to_bed_12.txt";
+    const int mission_id = 4211;
+
+    // Caller side message construction
+    QString last;
+    double old_caller = run("old: std::string + -> QString", [&](int i) {
+        std::string msg = "Mission " + filename.toStdString() + " completed successfully. MissionID: " + std::to_string(mission_id + i);
+        last = QString(msg.c_str());
+    });
+
+    LogQueue queue(1024);
+    LogRecord rec;
+    double new_caller = run("new: vsnprintf into ring slot (+ pop)", [&](int i) {
+        vpush(queue, "Mission %s completed successfully. MissionID: %d", qPrintable(filename), mission_id + i);
+        queue.pop(rec);
+    });
+
+    // File side line formatting
+    QByteArray sink;
+    sink.reserve(64 * 1024 * 1024);
+    QBuffer buffer(&sink);
+    buffer.open(QIODevice::WriteOnly);
+    double old_file = run("old: QDateTime::toString + QTextStream", [&](int i) {
+        Q_UNUSED(i);
+        QString timeStamp = QDateTime::currentDateTime().toString("[ddd dd:MM:yy-hh:mm:ss]");
+        QTextStream ts(&buffer);
+        ts << timeStamp << " " << last << endl;
+    });
+
+    LogFormatter formatter;
+    std::string out;
+    out.reserve(64 * 1024);
+    double new_file = run("new: LogFormatter cached prefix", [&](int i) {
+        Q_UNUSED(i);
+        rec.timestamp_ms = QDateTime::currentMSecsSinceEpoch();
+        formatter.formatLine(rec, out);
+        if (out.size() > 60 * 1024) out.clear();
+    });
+
+    printf("\ncaller speedup %.1fx, file formatting speedup %.1fx\n", old_caller / new_caller, old_file / new_file);
+    return 0;
+}
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Console log formatting micro-benchmark
+# qmake && make && ./logformat_benchmark
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = logformat_benchmark
+TEMPLATE = app
+CONFIG += console c++11 release
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += logformat_benchmark.cpp \
+    ../Tools/logformat.cpp \
+    ../Tools/logqueue.cpp
+
+HEADERS += ../Tools/logformat.h \
+    ../Tools/logqueue.h
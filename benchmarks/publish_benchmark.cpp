@@ -0,0 +1,109 @@
+/**
+ * Compares the original RobotCommunication::publish(topic, field, value) path against the
+ * PayloadCache path, up to the message handed to async_client::publish.
+ *
+ *  old:  Json::Value + Json::FastWriter per call, payload string copied into a new message
+ *  new:  PayloadCache lookup (formatted once), shared payload referenced by the message
+ */
+#include <QCoreApplication>
+#include <mqtt/message.h>
+#include <jsoncpp/json/json.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Tools/payloadcache.h"
+
+static const int ITERATIONS = 200000;
+
+template <typename F>
+static double run(const char *name, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        func(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+    printf("%-48s %10.1f ns/publish\n", name, ns);
+    return ns;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const std::string status_topic = "robot_status";
+    const std::string location_topic = "robot_location";
+    const std::string mission_topic = "robot_command_status";
+    const std::vector<std::string> statuses = {"standby", "idle", "charging", "busy", "disabled", "error"};
+
+    // Dynamic location values, as published by the delivery / collection sequences
+    std::vector<std::string> beds;
+    for (int i = 1; i <= 24; i++)
+    {
+        beds.push_back("bed_" + std::to_string(i));
+    }
+
+    size_t bytes = 0;
+
+    // Fixed status strings
+    double old_status = run("old: status, FastWriter + copy", [&](int i) {
+        Json::Value message_json;
+        Json::FastWriter writer;
+        message_json["status"] = statuses[i % statuses.size()];
+        mqtt::message_ptr msg = mqtt::make_message(status_topic, writer.write(message_json), 1, true);
+        bytes += msg->get_payload().size();
+    });
+
+    PayloadCache cache;
+    double new_status = run("new: status, cached shared payload", [&](int i) {
+        Payload payload = cache.get(status_topic, "status", statuses[i % statuses.size()]);
+        mqtt::message_ptr msg = mqtt::make_message(status_topic, mqtt::binary_ref(payload), 1, true);
+        bytes += msg->get_payload().size();
+    });
+
+    // Boolean mission result
+    double old_bool = run("old: success bool, FastWriter + copy", [&](int i) {
+        Json::Value message_json;
+        Json::FastWriter writer;
+        message_json["success"] = (i & 1) != 0;
+        mqtt::message_ptr msg = mqtt::make_message(mission_topic, writer.write(message_json), 1, false);
+        bytes += msg->get_payload().size();
+    });
+
+    double new_bool = run("new: success bool, cached shared payload", [&](int i) {
+        Payload payload = cache.get(mission_topic, "success", (i & 1) != 0);
+        mqtt::message_ptr msg = mqtt::make_message(mission_topic, mqtt::binary_ref(payload), 1, false);
+        bytes += msg->get_payload().size();
+    });
+
+    // Dynamic bed_N location
+    double old_bed = run("old: location bed_N, FastWriter + copy", [&](int i) {
+        Json::Value message_json;
+        Json::FastWriter writer;
+        message_json["location"] = "bed_" + std::to_string(1 + i % 24);
+        mqtt::message_ptr msg = mqtt::make_message(location_topic, writer.write(message_json), 1, true);
+        bytes += msg->get_payload().size();
+    });
+
+    double new_bed = run("new: location bed_N, cached shared payload", [&](int i) {
+        Payload payload = cache.get(location_topic, "location", beds[i % beds.size()]);
+        mqtt::message_ptr msg = mqtt::make_message(location_topic, mqtt::binary_ref(payload), 1, true);
+        bytes += msg->get_payload().size();
+    });
+
+    // Uncached formatting, for values seen once
+    std::string out;
+    double new_format = run("new: formatField only (no cache)", [&](int i) {
+        out.clear();
+        PayloadCache::formatField(out, "location", beds[i % beds.size()]);
+        bytes += out.size();
+    });
+
+    printf("\nspeedup: status %.1fx, bool %.1fx, bed_N %.1fx (formatter alone %.1f ns vs FastWriter %.1f ns)\n",
+           old_status / new_status, old_bool / new_bool, old_bed / new_bed, new_format, old_bed);
+    printf("cache: %zu entries, %llu hits, %llu misses (%zu bytes)\n", cache.size(),
+           static_cast<unsigned long long>(cache.hitCount()), static_cast<unsigned long long>(cache.missCount()), bytes);
+    return 0;
+}
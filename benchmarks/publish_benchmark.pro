@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# MQTT publish path micro-benchmark (payload serialization + message construction)
+# qmake && make && ./publish_benchmark
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = publish_benchmark
+TEMPLATE = app
+CONFIG += console c++11 release
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+LIBS += -lpaho-mqttpp3 -lpaho-mqtt3as -ljsoncpp
+
+SOURCES += publish_benchmark.cpp \
+    ../Tools/payloadcache.cpp
+
+HEADERS += ../Tools/payloadcache.h
@@ -0,0 +1,430 @@
+/**
+ * Compares telemetry payload serialization paths, up to the message handed to
+ * async_client::publish, for a pose / battery / step progress sample.
+ *
+ *  old:   Json::Value + Json::FastWriter per call, payload string copied into a new message
+ *  json:  PayloadWriter into a pooled buffer, referenced by the message
+ *  cbor:  Same, CBOR encoded
+ *
+ * Heap allocations per publish are counted by replacing the global operator new.
+ * Built with ENCODE_ONLY (qmake CONFIG+=encode_only) the message rows are left out and paho is
+ * not needed; only the serialization is measured then.
+ *
+ * Before timing anything the CBOR output is checked: RFC 8949 appendix A vectors for the item
+ * heads, floats and nesting, and a decode round trip of the sample against the Json::Value the
+ * old path builds. A failed check exits with status 1.
+ */
+#ifndef ENCODE_ONLY
+#include <mqtt/message.h>
+#endif
+#include <jsoncpp/json/json.h>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include "Tools/payloadwriter.h"
+
+static const int ITERATIONS = 200000;
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+struct Sample
+{
+    double x;
+    double y;
+    double theta;
+    double battery;
+    int mission_id;
+    int step;
+    const char *task;
+};
+
+template <typename F>
+static double run(const char *name, F func)
+{
+    size_t bytes = 0;
+    size_t start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        bytes += func(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+    printf("%-36s %8.1f ns/publish %6.1f bytes %5.2f allocations\n", name, ns, static_cast<double>(bytes) / ITERATIONS,
+           static_cast<double>(allocations - start_allocations) / ITERATIONS);
+    return ns;
+}
+
+static Sample sample(int i)
+{
+    Sample s;
+    s.x = 12.5 + 0.013 * (i % 1000);
+    s.y = -3.25 + 0.007 * (i % 700);
+    s.theta = 0.001 * (i % 6283);
+    s.battery = 87.5 - 0.0001 * i;
+    s.mission_id = 1000 + i / 50;
+    s.step = i % 12;
+    s.task = "deliver_commode";
+    return s;
+}
+
+template <typename Writer>
+static void write(Writer &writer, const Sample &s)
+{
+    writer.beginMap(7);
+    writer.field("x", s.x);
+    writer.field("y", s.y);
+    writer.field("theta", s.theta);
+    writer.field("battery", s.battery);
+    writer.field("mission_id", s.mission_id);
+    writer.field("step", s.step);
+    writer.field("task", s.task);
+    writer.endMap();
+}
+
+static Json::Value toJson(const Sample &s)
+{
+    Json::Value message_json;
+    message_json["x"] = s.x;
+    message_json["y"] = s.y;
+    message_json["theta"] = s.theta;
+    message_json["battery"] = s.battery;
+    message_json["mission_id"] = s.mission_id;
+    message_json["step"] = s.step;
+    message_json["task"] = s.task;
+    return message_json;
+}
+
+/**
+ * Decodes the subset of CBOR PayloadWriter produces (definite lengths, text keys).
+ * Independent of the writer, returns false on anything malformed or left over.
+ */
+class CborReader
+{
+    public:
+        CborReader(const std::string &data) : data_(data) {}
+
+        bool read(Json::Value &value)
+        {
+            return item(value) && pos_ == data_.size();
+        }
+
+    private:
+        const std::string &data_;
+        size_t pos_ = 0;
+
+        bool bytes(int count, uint64_t &value)
+        {
+            if (pos_ + count > data_.size())
+            {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < count; i++)
+            {
+                value = (value << 8) | static_cast<uint8_t>(data_[pos_++]);
+            }
+            return true;
+        }
+
+        bool item(Json::Value &value)
+        {
+            if (pos_ >= data_.size())
+            {
+                return false;
+            }
+            uint8_t initial = static_cast<uint8_t>(data_[pos_++]);
+            uint8_t major = initial >> 5;
+            uint8_t info = initial & 0x1f;
+
+            if (major == 7)
+            {
+                uint64_t bits;
+                switch (info)
+                {
+                    case 20: value = false; return true;
+                    case 21: value = true; return true;
+                    case 22: value = Json::Value(); return true;
+                    case 26:
+                    {
+                        if (!bytes(4, bits)) return false;
+                        uint32_t single_bits = static_cast<uint32_t>(bits);
+                        float single;
+                        memcpy(&single, &single_bits, sizeof(single));
+                        value = static_cast<double>(single);
+                        return true;
+                    }
+                    case 27:
+                    {
+                        if (!bytes(8, bits)) return false;
+                        double number;
+                        memcpy(&number, &bits, sizeof(number));
+                        value = number;
+                        return true;
+                    }
+                    default: return false;
+                }
+            }
+
+            uint64_t argument = info;
+            if (info == 24 || info == 25 || info == 26 || info == 27)
+            {
+                if (!bytes(1 << (info - 24), argument)) return false;
+            }
+            else if (info > 23)
+            {
+                return false;
+            }
+
+            switch (major)
+            {
+                case 0:
+                    // Signed when it fits, like Json::Reader, so values compare equal
+                    if (argument <= static_cast<uint64_t>(std::numeric_limits<Json::Int64>::max()))
+                        value = static_cast<Json::Int64>(argument);
+                    else
+                        value = static_cast<Json::UInt64>(argument);
+                    return true;
+                case 1:
+                    value = static_cast<Json::Int64>(-1 - static_cast<int64_t>(argument));
+                    return true;
+                case 3:
+                    if (pos_ + argument > data_.size()) return false;
+                    value = data_.substr(pos_, argument);
+                    pos_ += argument;
+                    return true;
+                case 4:
+                    value = Json::Value(Json::arrayValue);
+                    for (uint64_t i = 0; i < argument; i++)
+                    {
+                        Json::Value element;
+                        if (!item(element)) return false;
+                        value.append(element);
+                    }
+                    return true;
+                case 5:
+                    value = Json::Value(Json::objectValue);
+                    for (uint64_t i = 0; i < argument; i++)
+                    {
+                        Json::Value key;
+                        if (!item(key) || !key.isString() || !item(value[key.asString()])) return false;
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+};
+
+static std::string hex(const std::string &data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (unsigned char c : data)
+    {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0xf]);
+    }
+    return out;
+}
+
+template <typename F>
+static bool expect(const char *name, const char *expected, F encode)
+{
+    std::string encoded;
+    PayloadWriter writer(encoded, PayloadWriter::Format::Cbor);
+    encode(writer);
+    if (hex(encoded) == expected)
+    {
+        return true;
+    }
+    printf("CBOR check failed: %s encoded as %s, expected %s\n", name, hex(encoded).c_str(), expected);
+    return false;
+}
+
+static bool verifyCbor()
+{
+    typedef PayloadWriter W;
+    bool ok = true;
+
+    // RFC 8949 appendix A: every head length and both integer signs
+    const struct { int64_t value; const char *cbor; } integers[] = {
+        {0, "00"}, {1, "01"}, {10, "0a"}, {23, "17"}, {24, "1818"}, {25, "1819"}, {100, "1864"},
+        {1000, "1903e8"}, {1000000, "1a000f4240"}, {1000000000000LL, "1b000000e8d4a51000"},
+        {-1, "20"}, {-10, "29"}, {-100, "3863"}, {-1000, "3903e7"}
+    };
+    for (const auto &vector : integers)
+    {
+        ok &= expect(std::to_string(vector.value).c_str(), vector.cbor, [&](W &w) { w.value(vector.value); });
+    }
+    ok &= expect("INT64_MIN", "3b7fffffffffffffff", [](W &w) { w.value(std::numeric_limits<int64_t>::min()); });
+
+    // Floats: the single precision form whenever exact, double otherwise (never half precision)
+    const struct { double value; const char *cbor; } floats[] = {
+        {100000.0, "fa47c35000"}, {3.4028234663852886e+38, "fa7f7fffff"}, {1.1, "fb3ff199999999999a"},
+        {1.0e+300, "fb7e37e43c8800759c"}, {-4.1, "fbc010666666666666"},
+        {std::numeric_limits<double>::infinity(), "fa7f800000"}, {-std::numeric_limits<double>::infinity(), "faff800000"}
+    };
+    for (const auto &vector : floats)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%g", vector.value);
+        ok &= expect(name, vector.cbor, [&](W &w) { w.value(vector.value); });
+    }
+    ok &= expect("NaN", "fa7fc00000", [](W &w) { w.value(std::numeric_limits<double>::quiet_NaN()); });
+
+    ok &= expect("false", "f4", [](W &w) { w.value(false); });
+    ok &= expect("true", "f5", [](W &w) { w.value(true); });
+    ok &= expect("null", "f6", [](W &w) { w.null(); });
+    ok &= expect("\"\"", "60", [](W &w) { w.value(""); });
+    ok &= expect("\"IETF\"", "6449455446", [](W &w) { w.value("IETF"); });
+    ok &= expect("\"\\u00fc\"", "62c3bc", [](W &w) { w.value("\xc3\xbc"); });
+
+    // Nesting
+    ok &= expect("[]", "80", [](W &w) { w.beginArray(0); w.endArray(); });
+    ok &= expect("{}", "a0", [](W &w) { w.beginMap(0); w.endMap(); });
+    ok &= expect("[1, [2, 3], [4, 5]]", "8301820203820405", [](W &w) {
+        w.beginArray(3);
+        w.value(1);
+        w.beginArray(2); w.value(2); w.value(3); w.endArray();
+        w.beginArray(2); w.value(4); w.value(5); w.endArray();
+        w.endArray();
+    });
+    ok &= expect("{\"a\": 1, \"b\": [2, 3]}", "a26161016162820203", [](W &w) {
+        w.beginMap(2);
+        w.field("a", 1);
+        w.key("b"); w.beginArray(2); w.value(2); w.value(3); w.endArray();
+        w.endMap();
+    });
+    ok &= expect("[\"a\", {\"b\": \"c\"}]", "826161a161626163", [](W &w) {
+        w.beginArray(2);
+        w.value("a");
+        w.beginMap(1); w.field("b", "c"); w.endMap();
+        w.endArray();
+    });
+    ok &= expect("[1, 2, ... 25]", "98190102030405060708090a0b0c0d0e0f101112131415161718181819", [](W &w) {
+        w.beginArray(25);
+        for (int i = 1; i <= 25; i++) w.value(i);
+        w.endArray();
+    });
+
+    // Round trip of the telemetry sample, decoded values must equal what Json::Value holds
+    std::string encoded;
+    for (int i = 0; i < 1000; i++)
+    {
+        Sample s = sample(i * 197);
+        Json::Value expected = toJson(s);
+        for (PayloadWriter::Format format : {PayloadWriter::Format::Cbor, PayloadWriter::Format::Json})
+        {
+            PayloadWriter writer(encoded, format);
+            write(writer, s);
+            Json::Value decoded;
+            bool read = (format == PayloadWriter::Format::Cbor)? CborReader(encoded).read(decoded)
+                                                                 : Json::Reader().parse(encoded, decoded);
+            if (!read || decoded != expected)
+            {
+                printf("CBOR check failed: %s round trip of sample %d\n",
+                       (format == PayloadWriter::Format::Cbor)? "cbor" : "json", i * 197);
+                return false;
+            }
+        }
+    }
+
+    if (ok)
+    {
+        printf("CBOR check: RFC 8949 vectors and sample round trip ok\n\n");
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    if (!verifyCbor())
+    {
+        return 1;
+    }
+
+#ifndef ENCODE_ONLY
+    const std::string topic = "robot_1/robot_progress";
+
+    double old_ns = run("old: FastWriter + copy", [&](int i) {
+        Json::FastWriter writer;
+        mqtt::message_ptr msg = mqtt::make_message(topic, writer.write(toJson(sample(i))), 1, false);
+        return msg->get_payload().size();
+    });
+#else
+    double old_ns = run("old: FastWriter", [&](int i) {
+        Json::FastWriter writer;
+        return writer.write(toJson(sample(i))).size();
+    });
+#endif
+
+    std::string encoded;
+    double json_ns = run("json: PayloadWriter, encode only", [&](int i) {
+        PayloadWriter writer(encoded, PayloadWriter::Format::Json);
+        write(writer, sample(i));
+        return encoded.size();
+    });
+
+    double cbor_ns = run("cbor: PayloadWriter, encode only", [&](int i) {
+        PayloadWriter writer(encoded, PayloadWriter::Format::Cbor);
+        write(writer, sample(i));
+        return encoded.size();
+    });
+
+#ifndef ENCODE_ONLY
+    PayloadPool pool;
+    double json_msg_ns = run("json: pooled buffer + message", [&](int i) {
+        std::shared_ptr<std::string> buffer = pool.acquire();
+        PayloadWriter writer(*buffer, PayloadWriter::Format::Json);
+        write(writer, sample(i));
+        Payload payload = buffer;
+        mqtt::message_ptr msg = mqtt::make_message(topic, mqtt::binary_ref(payload), 1, false);
+        return msg->get_payload().size();
+    });
+
+    double cbor_msg_ns = run("cbor: pooled buffer + message", [&](int i) {
+        std::shared_ptr<std::string> buffer = pool.acquire();
+        PayloadWriter writer(*buffer, PayloadWriter::Format::Cbor);
+        write(writer, sample(i));
+        Payload payload = buffer;
+        mqtt::message_ptr msg = mqtt::make_message(topic, mqtt::binary_ref(payload), 1, false);
+        return msg->get_payload().size();
+    });
+
+    printf("\nspeedup vs FastWriter: json %.1fx, cbor %.1fx (encode only %.1fx / %.1fx)\n",
+           old_ns / json_msg_ns, old_ns / cbor_msg_ns, old_ns / json_ns, old_ns / cbor_ns);
+    printf("pool: %llu buffers reused, %llu allocated\n", static_cast<unsigned long long>(pool.reusedCount()),
+           static_cast<unsigned long long>(pool.allocatedCount()));
+#else
+    printf("\nspeedup vs FastWriter (encode only): json %.1fx, cbor %.1fx\n", old_ns / json_ns, old_ns / cbor_ns);
+#endif
+    return 0;
+}
@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Telemetry payload encoding micro-benchmark (Json::FastWriter vs PayloadWriter JSON / CBOR)
+# Checks the CBOR output against RFC 8949 vectors first.
+# qmake && make && ./telemetry_benchmark
+# qmake CONFIG+=encode_only && make && ./telemetry_benchmark     (serialization only, no paho)
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = telemetry_benchmark
+TEMPLATE = app
+CONFIG += console c++11 release
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+LIBS += -ljsoncpp
+
+encode_only {
+    DEFINES += ENCODE_ONLY
+} else {
+    LIBS += -lpaho-mqttpp3 -lpaho-mqtt3as
+}
+
+SOURCES += telemetry_benchmark.cpp \
+    ../Tools/payloadcache.cpp \
+    ../Tools/payloadwriter.cpp
+
+HEADERS += ../Tools/payloadcache.h \
+    ../Tools/payloadwriter.h
@@ -1,11 +1,18 @@
 #include "commandprocessor.h"
 
-CommandProcessor::CommandProcessor(boost::function<int (QByteArray)> sendMission, Console *console, RobotCommunication *com)
+CommandProcessor::CommandProcessor(boost::function<int (QByteArray)> sendMission, Console *console, RobotCommunication *com, FlightRecorder *recorder)
 {
     sendMission_ = sendMission;
     console_ = console;
     com_ = com;
-
+    recorder_ = recorder;
+
+    // State topics: published retained, repeats suppressed, only the latest value sent after an outage
+    com_->addStateTopic(ROBOT_STATUS_TOPIC);
+    com_->addStateTopic(ROBOT_LOCATION_TOPIC);
+    com_->setLastWill(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_OFFLINE);
+    // Mission results survive a restart while the broker is down, the scheduler waits for them
+    com_->addDurableTopic(MISSION_STATUS_TOPIC);
 }
 
 void CommandProcessor::executeMission(QString mission_cmd, QString data_path, boost::function<void (bool)> completionCallback)
@@ -16,15 +23,78 @@ void CommandProcessor::executeMission(QString mission_cmd, QString data_path, bo
 
 void CommandProcessor::executeMission(QString mission_cmd, QString data_path)
 {
+    if (this->isRunning())
+    {
+        return;
+    }
     mission_file_directory_ = data_path;
     task_manager_command = mission_cmd;
+    task_manager_parsed = false;
+    request_ = RequestContext();
     this->start();
     //mission_thread_ = new std::thread(&CommandProcessor::taskManager, this, mission_cmd);
 }
 
+void CommandProcessor::executeMission(const Json::Value &message, QString data_path, const RequestContext &request)
+{
+    if (this->isRunning())
+    {
+        return;
+    }
+    mission_file_directory_ = data_path;
+    task_manager_message = message;
+    task_manager_parsed = true;
+    request_ = request;
+    this->start();
+}
+
+void CommandProcessor::rejectCommand(const std::string &command, const std::string &reason, const RequestContext &request)
+{
+    CONSOLE_WARN(console_, LogTag::Mission, "Command %s rejected: %s", command.c_str(), reason.c_str());
+    com_->publishReply(request, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL, command + ": " + reason);
+}
+
+void CommandProcessor::acknowledgeDuplicate(const std::string &command, const std::string &key, const RequestContext &request)
+{
+    Json::Value message_json;
+    Json::FastWriter writer;
+    message_json["duplicate"] = key;
+    message_json["message"] = command + ": duplicate, already accepted";
+    com_->publishReply(request, MISSION_STATUS_TOPIC, writer.write(message_json));
+}
+
 void CommandProcessor::run()
 {
-    taskManager(task_manager_command);
+    CrashHandler::ThreadStack alternate_stack;
+    if (task_manager_parsed)
+    {
+        taskManager(task_manager_message);
+    }
+    else
+    {
+        taskManager(task_manager_command);
+    }
+}
+
+void CommandProcessor::record(flight::EventType event, int32_t mission_id, const std::string &name, int32_t status)
+{
+    if (recorder_ != NULL)
+    {
+        recorder_->record(event, mission_id, name, status);
+    }
+}
+
+void CommandProcessor::publishProgress(const std::string &task, const char *state, int32_t status)
+{
+    com_->publishEncoded(ROBOT_PROGRESS_TOPIC, [&](PayloadWriter &writer) {
+        writer.beginMap(5);
+        writer.field("mission_id", mission_id_.load());
+        writer.field("task", task);
+        writer.field("step", task_step_);
+        writer.field("state", state);
+        writer.field("status", static_cast<int>(status));
+        writer.endMap();
+    });
 }
 
 bool CommandProcessor::sendTask(QString file_name)
@@ -41,47 +111,59 @@ bool CommandProcessor::sendTask(QString file_name)
             bjsonstr = file.readAll();
             file.close();
 
-            console_->print("Starting Mission " + filename.toStdString());
+            // The context carries the ID from the start line on, no line keeps the previous one
             mission_id_ = sendMission_(bjsonstr);
+            LogContext::setMission(mission_id_);
+            CONSOLE_INFO(console_, LogTag::Mission, "Starting Mission %s", qPrintable(filename));
             response_received_ = false;
             robotTask = file_name;
+            CrashHandler::setActiveTask(file_name.toUtf8().constData(), mission_id_);
+            record(flight::kEventTaskStart, mission_id_, file_name.toStdString());
+            task_step_++;
+            publishProgress(file_name.toStdString(), "running");
 
             std::unique_lock<std::mutex> lck(mtx_);
             if(!taskCondition.wait_for(lck, std::chrono::minutes(10), [&]{return response_received_;}))
             {
-                console_->print("Error: Timeout waiting for mission completion. MissionID: " + std::to_string(mission_id_));
+                CONSOLE_ERROR(console_, LogTag::Mission, "Timeout waiting for mission completion. MissionID: %d", mission_id_.load());
+                record(flight::kEventTaskResult, mission_id_, file_name.toStdString(), -1);
+                publishProgress(file_name.toStdString(), "timeout", -1);
                 return false;
             }
             else
             {
                 if (mission_response_id_ == mission_id_)
                 {
+                    record(flight::kEventTaskResult, mission_id_, file_name.toStdString(), mission_status_);
+                    publishProgress(file_name.toStdString(), (mission_status_ == kErrorNone)? "done" : "failed", mission_status_);
                     // Refer fsm_defs.h (I2R Communication Protocol Constants)
                     if(mission_status_ == kErrorNone)
                     {
-                        console_->print("Mission " + filename.toStdString() + " completed successfully");
+                        CONSOLE_INFO(console_, LogTag::Mission, "Mission %s completed successfully", qPrintable(filename));
                         success = true;
                     }
                     else
                     {
-                        console_->print("ERROR: Mission " + filename.toStdString() + " failed");
+                        CONSOLE_ERROR(console_, LogTag::Mission, "Mission %s failed", qPrintable(filename));
                     }
                 }
                 else
                 {
-                    console_->print("Error: Response mismatch. MissionID: " + std::to_string(mission_id_) + "\tResponseID: " + std::to_string(mission_response_id_));
+                    CONSOLE_ERROR(console_, LogTag::Mission, "Response mismatch. MissionID: %d\tResponseID: %d", mission_id_.load(), mission_response_id_.load());
+                    record(flight::kEventTaskResult, mission_id_, file_name.toStdString(), -2);
+                    publishProgress(file_name.toStdString(), "failed", -2);
                 }
             }
         }
         else
         {
-            console_->print("Error Trying to send mission file " + filename.toStdString() + ". Cannot Open File!");
+            CONSOLE_ERROR(console_, LogTag::Mission, "Cannot send mission file %s. Cannot Open File!", qPrintable(filename));
         }
 
     }
     else
     {
-        console_->print("Error Trying to send mission file " + filename.toStdString() + ". File Not Found!");
+        CONSOLE_ERROR(console_, LogTag::Mission, "Cannot send mission file %s. File Not Found!", qPrintable(filename));
     }
 
     return success;
@@ -89,6 +171,7 @@ bool CommandProcessor::sendTask(QString file_name)
 
 void CommandProcessor::subMissionCompletionCallback(int sub_mission_id, int sub_mission_status)
 {
+    record(flight::kEventRobotResponse, sub_mission_id, std::string(), sub_mission_status);
     mission_response_id_ = sub_mission_id;
     mission_status_ = sub_mission_status;
     response_received_ = true;
@@ -107,6 +190,7 @@ void CommandProcessor::cancelMission()
 void CommandProcessor::initRobotState(RobotState state)
 {
     robotState = state;
+    record(flight::kEventStateChange, mission_id_, std::string(), static_cast<int32_t>(state));
 
     switch (state)
     {
@@ -121,18 +205,32 @@ void CommandProcessor::initRobotState(RobotState state)
 
 void CommandProcessor::taskManager(QString command)
 {
-    bool taskSuccess = false;
     Json::Value message;
     Json::Reader reader;
     if ( reader.parse( command.toStdString(), message ) == false )
     {
-        console_->print("Cannot Decode incoming JSON Command: " + command.toStdString());
+        CONSOLE_ERROR(console_, LogTag::Mission, "Cannot Decode incoming JSON Command: %s", qPrintable(command));
         if (completionCallback_ != NULL)
         {
-            completionCallback_(taskSuccess);
+            completionCallback_(false);
         }
         return;
     }
+    taskManager(message);
+}
+
+void CommandProcessor::taskManager(Json::Value message)
+{
+    bool taskSuccess = false;
+    int32_t bed_id = -1;
+    if (message["bed_id"].isIntegral())     bed_id = message["bed_id"].asInt();
+    else if (message["bed_id"].isString())  bed_id = atoi(message["bed_id"].asCString());
+    record(flight::kEventMissionStart, 0, message["command"].asString(), bed_id);
+    task_step_ = 0;
+    // Lines printed by this thread are tagged with the command (and mission ID once sent),
+    // nothing of the previous command carries over
+    LogContext::clear();
+    LogContext::setCommand(message["command"].asString().c_str());
 
     if (robotState != RobotState::Disabled)
     {
@@ -143,6 +241,8 @@ void CommandProcessor::taskManager(QString command)
 
     if (message["command"] == "shutdown")
     {
+        // Answered first, there is no reply once the machine goes down
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         system("echo NUC717 | sudo -S shutdown now");
     }
 
@@ -156,13 +256,13 @@ void CommandProcessor::taskManager(QString command)
             robotState = RobotState::Charging;
             // Self Test is a previous state resetting event
             previousRobotState = robotState;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
             com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_CHARGING);
         }
         else
         {
             robotState = RobotState::Error;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
     }
 
@@ -172,7 +272,7 @@ void CommandProcessor::taskManager(QString command)
         RobotState newState = (robotState == RobotState::Disabled)? previousRobotState : robotState;
 
         taskSuccess = true;
-        com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         initRobotState(newState);
     }
 
@@ -182,7 +282,7 @@ void CommandProcessor::taskManager(QString command)
         previousRobotState = robotState;
         robotState = RobotState::Disabled;
         taskSuccess = true;
-        com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_DISABLED);
 
     }
@@ -197,14 +297,14 @@ void CommandProcessor::taskManager(QString command)
             robotState = RobotState::Charging;
             // Dock is a previous state resetting event
             previousRobotState = robotState;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
             com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_CHARGING);
             com_->publish(ROBOT_LOCATION_TOPIC, ROBOT_LOCATION_FIELD, LOCATION_CHARGER);
         }
         else
         {
             robotState = RobotState::Error;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
     }
 
@@ -215,13 +315,13 @@ void CommandProcessor::taskManager(QString command)
         if (taskSuccess)  taskSuccess = sendTask(SAFETY_ON);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
             com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
         }
         else
         {
             robotState = RobotState::Error;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
     }
 
@@ -240,7 +340,7 @@ void CommandProcessor::taskManager(QString command)
 
         if (robotState != RobotState::Standby)
         {
-            //com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL, "Invalid Command. Robot not standby at parking");
+            rejectCommand("deliver", "robot not standby at parking", request_);
             initRobotState(robotState);
             return;
         }
@@ -263,11 +363,11 @@ void CommandProcessor::taskManager(QString command)
         // Publish Mission Status
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
 
         if (taskSuccess)  taskSuccess = sendTask(LF_BED_TO_HALLWAY_PREFIX + QString(message["bed_id"].asString().c_str()));
@@ -320,7 +420,7 @@ void CommandProcessor::taskManager(QString command)
 
         if (robotState != RobotState::Idle)
         {
-            //com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL, "Invalid Command. Robot not idle at parking");
+            rejectCommand("collect", "robot not idle at parking", request_);
             initRobotState(robotState);
             return;
         }
@@ -362,12 +462,12 @@ void CommandProcessor::taskManager(QString command)
             robotState = RobotState::Charging;
             // Reset the previous state
             previousRobotState = robotState;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
             robotState = RobotState::Error;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
     }
 
@@ -387,7 +487,7 @@ void CommandProcessor::taskManager(QString command)
 
         if (robotState != RobotState::Charging)
         {
-            //com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL, "Invalid Command. Robot not at Charger");
+            rejectCommand("park", "robot not at charger", request_);
             initRobotState(robotState);
             return;
         }
@@ -422,18 +522,19 @@ void CommandProcessor::taskManager(QString command)
             robotState = RobotState::Standby;
             // Reset the previous state
             previousRobotState = robotState;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
             robotState = RobotState::Error;
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
     }
 
     else if (message["command"] == "door_open")
     {
         taskSuccess = true;
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         com_->publish(DOOR_CONTROL_TOPIC, DOOR_CONTROL_FIELD, DOOR_OPEN);
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -441,6 +542,7 @@ void CommandProcessor::taskManager(QString command)
     else if (message["command"] == "door_close")
     {
         taskSuccess = true;
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         com_->publish(DOOR_CONTROL_TOPIC, DOOR_CONTROL_FIELD, DOOR_CLOSE);
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -450,11 +552,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(SAFETY_ON);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -464,11 +566,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(SAFETY_OFF);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -478,11 +580,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_EXTEND);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -492,11 +594,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_RETRACT);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -506,11 +608,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_CLAMP);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -520,11 +622,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_RELEASE);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -534,11 +636,11 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_EXTENDED_CLAMP);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
@@ -548,22 +650,22 @@ void CommandProcessor::taskManager(QString command)
         taskSuccess = sendTask(GRIPPER_EXTENDED_RELEASE);
         if(taskSuccess)
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
         }
         else
         {
-            com_->publish(MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
+            com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL);
         }
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
 
     else if (message["command"] == "cancel_mission")
     {
-        console_->print("Last sub task: " + robotTask.toStdString());
-        console_->print("Cancelling mission");
+        CONSOLE_INFO(console_, LogTag::Mission, "Last sub task: %s", qPrintable(robotTask));
+        CONSOLE_INFO(console_, LogTag::Mission, "Cancelling mission");
         if (previousRobotState == RobotState::Standby)
         {
-            console_->print("Going back to Standby State");
+            CONSOLE_INFO(console_, LogTag::Mission, "Going back to Standby State");
             if (robotTask == SAFETY_ON)
             {
                 taskSuccess = sendTask(SAFETY_ON);
@@ -571,14 +673,14 @@ void CommandProcessor::taskManager(QString command)
             }
             else if (robotTask == LF_PARKING_EXIT)
             {
-                console_->print("go back from park exit");
+                CONSOLE_DEBUG(console_, LogTag::Mission, "go back from park exit");
                 taskSuccess = sendTask(SAFETY_ON);
                 if (taskSuccess)  taskSuccess = sendTask(LF_HALLWAY_TO_PARKING);
                 if (!taskSuccess) robotTask = LF_PARKING_EXIT;                            // Fallback if cancel error
             }
             else if (robotTask == LF_HALLWAY_TO_BED_PREFIX + last_bed_id)
             {
-                console_->print("go back from lf");
+                CONSOLE_DEBUG(console_, LogTag::Mission, "go back from lf");
                 taskSuccess = sendTask(SAFETY_ON);
                 if (taskSuccess)  taskSuccess = sendTask(LF_BED_TO_HALLWAY_PREFIX + last_bed_id);
                 if (!taskSuccess) robotTask = LF_HALLWAY_TO_BED_PREFIX + last_bed_id;     // Fallback if cancel error
@@ -591,14 +693,14 @@ void CommandProcessor::taskManager(QString command)
                 taskSuccess = true;
             }
 
-            console_->print("Last mission check statement: " + LF_HALLWAY_TO_BED_PREFIX.toStdString() + last_bed_id.toStdString());
+            CONSOLE_DEBUG(console_, LogTag::Mission, "Last mission check statement: %s%s", qPrintable(LF_HALLWAY_TO_BED_PREFIX), qPrintable(last_bed_id));
             // Publish location
             if (taskSuccess)  com_->publish(ROBOT_LOCATION_TOPIC, ROBOT_LOCATION_FIELD, LOCATION_PARKING);
         }
 
         else if (previousRobotState == RobotState::Idle)
         {
-            console_->print("Going back to Idle state");
+            CONSOLE_INFO(console_, LogTag::Mission, "Going back to Idle state");
             if (robotTask == SAFETY_ON)
             {
                 taskSuccess = sendTask(SAFETY_ON);
@@ -630,7 +732,7 @@ void CommandProcessor::taskManager(QString command)
 
         else if (previousRobotState == RobotState::Charging)
         {
-            console_->print("Going back to Charging State");
+            CONSOLE_INFO(console_, LogTag::Mission, "Going back to Charging State");
             if (robotTask == UNDOCK_FROM_CHARGER)
             {
                 taskSuccess = sendTask(SAFETY_OFF);
@@ -661,19 +763,30 @@ void CommandProcessor::taskManager(QString command)
         }
         else
         {
-            console_->print("Cannot go back since previous state is not initialized");
+            CONSOLE_WARN(console_, LogTag::Mission, "Cannot go back since previous state is not initialized");
         }
 
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, taskSuccess? MISSION_SUCCESS : MISSION_FAIL);
         // Reinitialize State
         if (taskSuccess) initRobotState(previousRobotState);
     }
 
+    else if (message["command"] == "abort")
+    {
+        // The running mission was cancelled before this one got dispatched, status published below
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_SUCCESS);
+    }
+
     else
     {
-        console_->print("Error: Unknown Command: " + message["command"].asString());
+        CONSOLE_ERROR(console_, LogTag::Mission, "Unknown Command: %s", message["command"].asString().c_str());
+        com_->publishReply(request_, MISSION_STATUS_TOPIC, MISSION_STATUS_FIELD, MISSION_FAIL,
+                           message["command"].asString() + ": unknown command");
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
 
+    record(flight::kEventMissionEnd, mission_id_, message["command"].asString(), taskSuccess? 1 : 0);
+
     // Callback
     if (completionCallback_ != NULL)
     {
@@ -682,19 +795,21 @@ void CommandProcessor::taskManager(QString command)
     // Publish Robot Status
     if (taskSuccess)
     {
-        console_->print(message["command"].asString() + " : Mission Successfull");
+        CONSOLE_INFO(console_, LogTag::Mission, "%s : Mission Successfull", message["command"].asString().c_str());
     }
     else if (message["command"] == "abort")
     {
-        console_->print(message["command"].asString() + " : Success");
+        CONSOLE_INFO(console_, LogTag::Mission, "%s : Success", message["command"].asString().c_str());
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_IDLE);
     }
     else
     {
-        console_->print(message["command"].asString() + " : Mission Failed");
+        CONSOLE_ERROR(console_, LogTag::Mission, "%s : Mission Failed", message["command"].asString().c_str());
         com_->publish(ROBOT_STATUS_TOPIC, ROBOT_STATUS_FIELD, ROBOT_STATUS_ERROR);
         // At least try to turn on safety, in case of error
         // sendTask(SAFETY_ON);
     }
+    LogContext::clear();
+    CrashHandler::clearActiveTask();
     return;
 }
@@ -13,6 +13,8 @@
 #include <jsoncpp/json/reader.h>
 #include <jsoncpp/json/json.h>
 #include "Tools/robotCommunication.h"
+#include "Tools/flightrecorder.h"
+#include "Tools/crashhandler.h"
 #include <mutex>
 #include <thread>
 #include <atomic>
@@ -35,11 +37,29 @@ class CommandProcessor : public QThread
          * @brief CommandProcessor
          * @param sendMission       SendMission Function pointer that accepts I2R Mission JSON file, to be sent to robot
          * @param console           Console object pointer that has print and clear functions
+         * @param recorder          Optional flight recorder for mission steps and robot responses
          */
-        CommandProcessor(boost::function<int (QByteArray)> sendMission, Console *console, RobotCommunication *com);
+        CommandProcessor(boost::function<int (QByteArray)> sendMission, Console *console, RobotCommunication *com, FlightRecorder *recorder = NULL);
 
         void executeMission(QString mission_cmd, QString data_path, boost::function<void (bool)> completionCallback);
         void executeMission(QString mission_cmd, QString data_path);
+
+        /**
+         * @brief executeMission    Run an already parsed command. Does nothing while a command is running.
+         * @param request           Mission status replies also go to the request's response topic
+         */
+        void executeMission(const Json::Value &message, QString data_path, const RequestContext &request = RequestContext());
+
+        /**
+         * @brief rejectCommand     Answer a command that will not be executed on the mission status topic
+         */
+        void rejectCommand(const std::string &command, const std::string &reason, const RequestContext &request = RequestContext());
+
+        /**
+         * @brief acknowledgeDuplicate  Answer a redelivered command without executing it again.
+         * Carries no "success" field, the outcome is reported once by the original command.
+         */
+        void acknowledgeDuplicate(const std::string &command, const std::string &key, const RequestContext &request = RequestContext());
         void cancelMission();
         void initRobotState(RobotState state);
 
@@ -52,6 +72,7 @@ class CommandProcessor : public QThread
         boost::function<int (QByteArray)> sendMission_;
         boost::function<void (bool)> completionCallback_;
         RobotCommunication *com_;
+        FlightRecorder *recorder_;
 
         std::mutex mtx_;
         std::condition_variable taskCondition;
@@ -61,6 +82,10 @@ class CommandProcessor : public QThread
         std::atomic<int> mission_id_;
         std::atomic<bool> mission_status_;
         QString task_manager_command;
+        Json::Value task_manager_message;
+        bool task_manager_parsed = false;
+        RequestContext request_;
+        int task_step_ = 0;
 
         RobotState robotState = RobotState::Charging;
         RobotState previousRobotState = robotState;
@@ -71,6 +96,7 @@ class CommandProcessor : public QThread
         const std::string ROBOT_STATUS_TOPIC    { "robot_status" };
         const std::string DOOR_CONTROL_TOPIC    { "door_control" };
         const std::string ROBOT_LOCATION_TOPIC  { "robot_location" };
+        const std::string ROBOT_PROGRESS_TOPIC  { "robot_progress" };   // Step telemetry, see publishProgress
 
         const std::string MISSION_STATUS_FIELD          {"success"};
         const std::string ROBOT_STATUS_FIELD            {"status"};
@@ -83,6 +109,7 @@ class CommandProcessor : public QThread
         const std::string ROBOT_STATUS_BUSY             {"busy"};
         const std::string ROBOT_STATUS_DISABLED         {"disabled"};
         const std::string ROBOT_STATUS_ERROR            {"error"};
+        const std::string ROBOT_STATUS_OFFLINE          {"offline"};    // Last will
 
         // Robot Locations
         const std::string LOCATION_CHARGER                  {"charger"};
@@ -98,7 +125,15 @@ class CommandProcessor : public QThread
 
         void run();
         bool sendTask(QString file_name);
+        void record(flight::EventType event, int32_t mission_id, const std::string &name, int32_t status = 0);
+
+        /**
+         * @brief publishProgress   Mission step telemetry, in the encoding configured for the topic
+         * @param status            Robot mission status of a finished step (-1 timeout, -2 mismatch)
+         */
+        void publishProgress(const std::string &task, const char *state, int32_t status = 0);
         void taskManager(QString command);
+        void taskManager(Json::Value message);
 
         // TODO Delete
         QString last_bed_id;
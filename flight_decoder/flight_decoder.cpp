@@ -0,0 +1,132 @@
+/**
+ * Decodes a flight recorder ring file (see Tools/flightrecord.h) to text or CSV,
+ * oldest record first.
+ *
+ * Usage: flight_decoder [--csv] <file>
+ */
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "Tools/flightrecord.h"
+
+static std::string nameAt(const flight::FileHeader &header, uint16_t index)
+{
+    if (index == flight::NO_NAME || index >= header.name_count || index >= flight::MAX_NAMES)
+    {
+        return "";
+    }
+    return std::string(header.names[index], strnlen(header.names[index], flight::NAME_LENGTH));
+}
+
+static std::string formatTime(uint64_t timestamp_us)
+{
+    time_t seconds = static_cast<time_t>(timestamp_us / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%s.%06u", date, static_cast<unsigned>(timestamp_us % 1000000));
+    return buffer;
+}
+
+static std::string csvField(const std::string &value)
+{
+    std::string out = "\"";
+    for (char c : value)
+    {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+int main(int argc, char *argv[])
+{
+    bool csv = false;
+    const char *file_name = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else file_name = argv[i];
+    }
+    if (file_name == NULL)
+    {
+        fprintf(stderr, "Usage: %s [--csv] <flight recorder file>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL)
+    {
+        perror(file_name);
+        return 1;
+    }
+
+    flight::FileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != flight::FILE_MAGIC ||
+            header.version != flight::FILE_VERSION || header.record_size != sizeof(flight::Record) ||
+            header.capacity == 0)
+    {
+        fprintf(stderr, "%s: not a flight recorder file (or unsupported version)\n", file_name);
+        fclose(file);
+        return 1;
+    }
+
+    std::vector<flight::Record> records(header.capacity);
+    if (fseek(file, header.records_offset, SEEK_SET) != 0 ||
+            fread(records.data(), sizeof(flight::Record), header.capacity, file) != header.capacity)
+    {
+        fprintf(stderr, "%s: truncated file\n", file_name);
+        fclose(file);
+        return 1;
+    }
+    fclose(file);
+
+    if (csv)
+    {
+        printf("sequence,timestamp,timestamp_us,event,mission_id,name,status,detail\n");
+    }
+
+    uint64_t end = header.write_index;
+    uint64_t start = (end > header.capacity)? end - header.capacity : 0;
+    uint64_t skipped = 0;
+    for (uint64_t n = start; n < end; n++)
+    {
+        const flight::Record &rec = records[n % header.capacity];
+        if (rec.sequence != n + 1)
+        {
+            // Torn write at crash time or slot already overwritten
+            skipped++;
+            continue;
+        }
+
+        std::string name = nameAt(header, rec.name_index);
+        char detail[16] = "";
+        if (rec.detail_hash != 0)
+        {
+            snprintf(detail, sizeof(detail), "#%08x", rec.detail_hash);
+        }
+        if (csv)
+        {
+            printf("%llu,%s,%llu,%s,%d,%s,%d,%s\n", static_cast<unsigned long long>(rec.sequence),
+                   formatTime(rec.timestamp_us).c_str(), static_cast<unsigned long long>(rec.timestamp_us),
+                   flight::eventName(rec.event), rec.mission_id, csvField(name).c_str(), rec.status,
+                   detail);
+        }
+        else
+        {
+            printf("%8llu %s %-15s mission=%-8d status=%-4d %s%s%s\n", static_cast<unsigned long long>(rec.sequence),
+                   formatTime(rec.timestamp_us).c_str(), flight::eventName(rec.event), rec.mission_id, rec.status,
+                   name.c_str(), (detail[0] == '\0')? "" : " ", detail);
+        }
+    }
+
+    if (skipped > 0)
+    {
+        fprintf(stderr, "%llu incomplete records skipped\n", static_cast<unsigned long long>(skipped));
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Offline decoder for the SHARP flight recorder ring file
+# qmake && make && ./flight_decoder [--csv] iCube_SHARP_FlightRecorder
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = flight_decoder
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+INCLUDEPATH += ..
+
+SOURCES += flight_decoder.cpp
+
+HEADERS += ../Tools/flightrecord.h
@@ -40,6 +40,7 @@ void setRobotName(const QString &robot_name)
         gui_plugin::BaseWidget *basew = dynamic_cast<gui_plugin::BaseWidget *>(wid);
         if (basew)
         {
+            wid->setProperty(PROPERTY_ROBOT_NAME, robot_name);
             basew->setRobotName(robot_name);
         }
     }
@@ -10,6 +10,7 @@
 #include <QFile>
 #include <QDir>
 #include <QColor>
+#include <QTimer>
 #include "ui_plugin_template.h"
 #include "../../common/fsm_defs.h"
 #include <QDebug>
@@ -31,12 +32,25 @@ SHARP::SHARP(BaseWidget *parent) :
     ui->setupUi(this);
     ui->config_path_label->setText("No Configuration Path Specified");
 
-    console = new Console(ui->textEdit_status);
-    robot_com = new RobotCommunication(boost::bind(&SHARP::command_callback, this, _1), console);
-    console->print("## SUTD Commode Delivery System V1.3 ##");
-
-    cmd_processor = new CommandProcessor(boost::bind(&SHARP::sendMission, this, _1), console, robot_com);
-    QObject::connect(this, &gui_plugin::SHARP::mqtt_cb, this, &gui_plugin::SHARP::executeMQTTCommand);
+    console = new Console(ui->listView_status);
+    flight_recorder = new FlightRecorder("iCube_SHARP_FlightRecorder");
+    robot_com = new RobotCommunication(boost::bind(&SHARP::command_callback, this, _1, _2), console, flight_recorder);
+    mqtt_log_sink = new MqttLogSink(robot_com);
+    console->addSink(mqtt_log_sink);
+    CONSOLE_INFO(console, LogTag::Gui, "## SUTD Commode Delivery System V1.3 ##");
+
+    cmd_processor = new CommandProcessor(boost::bind(&SHARP::sendMission, this, _1), console, robot_com, flight_recorder);
+    // MQTT commands are queued on arrival, dispatched on the GUI thread whenever the processor is free
+    command_queue.addPreemptCommand("disable");
+    command_queue.addPreemptCommand("abort");
+    command_queue.addPreemptCommand("cancel_mission");
+    command_dedup.addIdOnly("disable");
+    command_dedup.addIdOnly("abort");
+    command_dedup.addIdOnly("cancel_mission");
+    // Never dropped by the inbound rate limit because of other commands
+    robot_com->setPriorityFilter(boost::bind(&CommandQueue::isPreempt, &command_queue, _1));
+    QObject::connect(this, &gui_plugin::SHARP::mqtt_cb, this, &gui_plugin::SHARP::dispatchMQTTCommands);
+    QObject::connect(cmd_processor, &QThread::finished, this, &gui_plugin::SHARP::dispatchMQTTCommands);
 
     /// Try to fetch default configuration file directory
     QString filename = QCoreApplication::applicationDirPath() + "/../mission_config.yaml";
@@ -44,17 +58,25 @@ SHARP::SHARP(BaseWidget *parent) :
     QFile file(filename);
     if(file.exists())
     {
-        console->print("Mission Configuration file found in " + filename.toStdString());
+        CONSOLE_INFO(console, LogTag::Gui, "Mission Configuration file found in %s", qPrintable(filename));
         YAML::Node config = YAML::LoadFile(filename.toStdString());
+        if (config["logging"])
+        {
+            configureLogging(config["logging"]);
+        }
+        if (config["mqtt"])
+        {
+            configureMqtt(config["mqtt"]);
+        }
         if (config["mission_files_dir"])
         {
             std::string dir = config["mission_files_dir"].as<std::string>();
             dir = (dir.at(0) == '/')? dir : QCoreApplication::applicationDirPath().toStdString() + "/../" + dir;
-            console->print("Default mission data directory: " + dir);
+            CONSOLE_INFO(console, LogTag::Gui, "Default mission data directory: %s", dir.c_str());
             QFileInfo config_directory(QString(dir.c_str()));
             if (config_directory.exists())
             {
-                console->print("Using default mission data directory");
+                CONSOLE_INFO(console, LogTag::Gui, "Using default mission data directory");
                 config_dir = QString(dir.c_str());
                 configured = true;
 
@@ -67,18 +89,25 @@ SHARP::SHARP(BaseWidget *parent) :
             }
             else
             {
-                console->print("Default mission data directory doesn't exist");
+                CONSOLE_WARN(console, LogTag::Gui, "Default mission data directory doesn't exist");
             }
 
         } else
         {
-            console->print("'mission_files_dir' parameter not found in config file");
+            CONSOLE_WARN(console, LogTag::Gui, "'mission_files_dir' parameter not found in config file");
         }
     }
     else
     {
-        console->print("Mission Configuration file 'mission_config.yaml' not found in " + filename.toStdString());
+        CONSOLE_WARN(console, LogTag::Gui, "Mission Configuration file 'mission_config.yaml' not found in %s", qPrintable(filename));
     }
+
+    // Connect once configured, publishes made meanwhile are buffered
+    QObject::connect(robot_com, &RobotCommunication::heartbeatUpdated, this, &gui_plugin::SHARP::updateLinkStatus);
+    QObject::connect(robot_com, &RobotCommunication::readyChanged, this, &gui_plugin::SHARP::updateLinkStatus);
+    updateLinkStatus();
+    // Deferred to the event loop, the host names the robot right after creating the widget
+    QTimer::singleShot(0, robot_com, &RobotCommunication::start);
 }
 
 /**
@@ -87,8 +116,14 @@ SHARP::SHARP(BaseWidget *parent) :
  */
 SHARP::~SHARP()
 {
+    // command_callback runs on the paho thread and uses cmd_processor, no command may arrive
+    // once it is gone. Detaching waits for a delivery in progress.
+    robot_com->end_communication();
     delete cmd_processor;
+    console->removeSink(mqtt_log_sink);
+    delete mqtt_log_sink;
     delete robot_com;
+    delete flight_recorder;
     delete console;
     delete ui;
 }
@@ -194,14 +229,14 @@ void SHARP::OnMissionCompleted(const QJsonObject &jobj)
         else
         {
             qCritical() << "Failed to decode mission complete data -" << jobj;
-            console->print("Failed to decode mission complete data");
+            CONSOLE_ERROR(console, LogTag::Gui, "Failed to decode mission complete data");
         }
 
     }
     else
     {
         qCritical() << "Missing payload for received robot status";
-        console->print("Missing payload for received sub mission status");
+        CONSOLE_ERROR(console, LogTag::Gui, "Missing payload for received sub mission status");
     }
 }
 
@@ -211,6 +246,10 @@ void SHARP::OnMissionCompleted(const QJsonObject &jobj)
  */
 void SHARP::onSetRobotName()
 {
+    // Namespace of this robot's topics in the shared MQTT session
+    QString robot_name = property(PROPERTY_ROBOT_NAME).toString();
+    CONSOLE_INFO(console, LogTag::Gui, "Robot name: %s", qPrintable(robot_name));
+    robot_com->setRobotName(robot_name.toStdString());
 }
 
 }
@@ -264,40 +303,305 @@ void gui_plugin::SHARP::on_config_button_clicked()
 void gui_plugin::SHARP::on_pushButton_Abort_clicked()
 {
     cmd_processor->cancelMission();
-    console->print("Mission Aborted by user!");
+    CONSOLE_INFO(console, LogTag::Gui, "Mission Aborted by user!");
     emit sendCommand(Command::kCommandMissionAbortActive,
                      SubCommand::kSubCommandUnknown,
                      "Aborting current mission",
                      QJsonObject());
 }
 
-void gui_plugin::SHARP::command_callback(std::string msg)
+void gui_plugin::SHARP::command_callback(std::string msg, const RequestContext &request)
+{
+    CONSOLE_DEBUG(console, LogTag::Mqtt, "MQTT payload: %s", msg.c_str());
+
+    // Parsed once here, on the MQTT thread
+    InboundCommand command;
+    command.request = request;
+    if (!CommandQueue::parse(msg, command))
+    {
+        CONSOLE_ERROR(console, LogTag::Mqtt, "Cannot Decode incoming JSON Command: %s", msg.c_str());
+        cmd_processor->rejectCommand("unknown", "invalid command", request);
+        return;
+    }
+
+    std::string &key = command.dedup_key;
+    if (command_dedup.check(command.name, command.message, key))
+    {
+        CommandDedup::Stats stats = command_dedup.stats();
+        CONSOLE_WARN(console, LogTag::Mqtt, "Duplicate command %s (%s) ignored, %llu duplicates (%llu by id, %llu by content)",
+                     command.name.c_str(), key.c_str(), static_cast<unsigned long long>(stats.hits),
+                     static_cast<unsigned long long>(stats.id_hits), static_cast<unsigned long long>(stats.hash_hits));
+        cmd_processor->acknowledgeDuplicate(command.name, key, request);
+        return;
+    }
+
+    std::vector<InboundCommand> discarded;
+    CommandQueue::Result result = command_queue.push(command, discarded);
+    for (const InboundCommand &stale : discarded)
+    {
+        cmd_processor->rejectCommand(stale.name, "discarded by " + command.name, stale.request);
+        command_dedup.forget(stale.dedup_key);
+    }
+
+    if (result == CommandQueue::Result::Full)
+    {
+        cmd_processor->rejectCommand(command.name, "command queue full", request);
+        command_dedup.forget(key);
+        return;
+    }
+    emit mqtt_cb(QString::fromStdString(command.name));
+}
+
+void gui_plugin::SHARP::configureLogging(const YAML::Node &config)
+{
+    const std::pair<const char *, Console::Sink> sinks[] = {
+        {"console", Console::Sink::View},
+        {"stdout", Console::Sink::Stdout},
+        {"file", Console::Sink::File}
+    };
+
+    for (const auto &sink : sinks)
+    {
+        if (!config[sink.first])
+        {
+            continue;
+        }
+        LogLevel level;
+        std::string name = config[sink.first].as<std::string>();
+        if (logLevelFromString(name, level))
+        {
+            console->setSinkLevel(sink.second, level);
+            CONSOLE_INFO(console, LogTag::Gui, "Log level for %s set to %s", sink.first, logLevelName(level));
+        }
+        else
+        {
+            CONSOLE_WARN(console, LogTag::Gui, "Unknown log level '%s' for %s", name.c_str(), sink.first);
+        }
+    }
+
+    LogLevel mqtt_level;
+    if (config["mqtt"] && logLevelFromString(config["mqtt"].as<std::string>(), mqtt_level))
+    {
+        console->setSinkLevel(mqtt_log_sink, mqtt_level);
+    }
+
+    // Log file rotation
+    LogWriter::RotationPolicy rotation;
+    if (config["rotate_size_mb"])   rotation.max_bytes = config["rotate_size_mb"].as<qint64>() * 1024 * 1024;
+    if (config["rotate_daily"])     rotation.daily = config["rotate_daily"].as<bool>();
+    if (config["retention"])        rotation.retention = config["retention"].as<int>();
+    if (config["compression"])
+    {
+        std::string compression = config["compression"].as<std::string>();
+        rotation.compression = (compression == "gzip")? LogCompressor::Compression::Gzip : LogCompressor::Compression::None;
+    }
+    console->setRotationPolicy(rotation);
+
+    // Lines are dropped (and counted) when the log ring is full, block trades that for stalls
+    if (config["overflow"] && config["overflow"].as<std::string>() == "block")
+    {
+        int timeout_us = config["block_timeout_us"]? config["block_timeout_us"].as<int>() : 2000;
+        console->setOverflowPolicy(LogQueue::OverflowPolicy::Block, timeout_us);
+        CONSOLE_INFO(console, LogTag::Gui, "Log ring full: printing threads wait up to %d us", timeout_us);
+    }
+}
+
+void gui_plugin::SHARP::configureMqtt(const YAML::Node &config)
 {
-    std::cout << msg << std::endl;
-    emit mqtt_cb(QString(msg.c_str()));
+    RobotCommunication::ServerOptions server;
+    if (config["servers"])
+    {
+        server.servers = config["servers"].as<std::vector<std::string>>();
+    }
+    if (config["switch_back_interval_ms"])  server.switch_back_interval_ms = config["switch_back_interval_ms"].as<int>();
+    if (config["client_id"])                server.client_id = config["client_id"].as<std::string>();
+    if (config["unique_client_id"])         server.unique_client_id = config["unique_client_id"].as<bool>();
+    if (config["instance_id"])              server.instance_id = config["instance_id"].as<std::string>();
+    if (config["command_topic"])            server.command_topic = config["command_topic"].as<std::string>();
+    if (config["robot_namespace"])          server.robot_namespace = config["robot_namespace"].as<bool>();
+    robot_com->setServerOptions(server);
+
+    RobotCommunication::LinkOptions options;
+    if (config["keep_alive_s"])             options.keep_alive_s = config["keep_alive_s"].as<int>();
+    if (config["presence_topic"])           options.presence_topic = config["presence_topic"].as<std::string>();
+    if (config["heartbeat_topic"])          options.heartbeat_topic = config["heartbeat_topic"].as<std::string>();
+    if (config["heartbeat_interval_ms"])    options.heartbeat_interval_ms = config["heartbeat_interval_ms"].as<int>();
+    if (config["heartbeat_timeout_ms"])     options.heartbeat_timeout_ms = config["heartbeat_timeout_ms"].as<int>();
+    if (config["heartbeat_max_missed"])     options.heartbeat_max_missed = config["heartbeat_max_missed"].as<int>();
+    if (config["session_expiry_s"])         options.session_expiry_s = config["session_expiry_s"].as<int>();
+    if (config["inflight_window"])          options.inflight_window = config["inflight_window"].as<int>();
+    if (config["ack_timeout_ms"])           options.ack_timeout_ms = config["ack_timeout_ms"].as<int>();
+    if (config["max_retries"])              options.max_retries = config["max_retries"].as<int>();
+    if (config["journal_file"])
+    {
+        std::string journal = config["journal_file"].as<std::string>();
+        options.journal_file = (journal.empty() || journal.at(0) == '/')? journal : QCoreApplication::applicationDirPath().toStdString() + "/../" + journal;
+    }
+    if (config["journal_sync_interval_ms"]) options.journal_sync_interval_ms = config["journal_sync_interval_ms"].as<int>();
+    robot_com->setLinkOptions(options);
+    if (config["topic_encodings"])
+    {
+        for (const auto &entry : config["topic_encodings"])
+        {
+            PayloadWriter::Format format;
+            std::string topic = entry.first.as<std::string>();
+            std::string name = entry.second.as<std::string>();
+            if (PayloadWriter::formatFromString(name, format))
+            {
+                robot_com->setTopicEncoding(topic, format);
+            }
+            else
+            {
+                CONSOLE_WARN(console, LogTag::Gui, "Unknown encoding '%s' for topic '%s', JSON used", name.c_str(), topic.c_str());
+            }
+        }
+    }
+    if (config["rate_limits"])
+    {
+        for (const auto &entry : config["rate_limits"])
+        {
+            RateLimiter::Limit limit;
+            std::string topic = entry.first.as<std::string>();
+            const YAML::Node &node = entry.second;
+            if (node["rate"])               limit.rate = node["rate"].as<double>();
+            if (node["burst"])              limit.burst = node["burst"].as<int>();
+            if (node["topic_rate"])         limit.topic_rate = node["topic_rate"].as<double>();
+            if (node["topic_burst"])        limit.topic_burst = node["topic_burst"].as<int>();
+            std::string policy = node["policy"]? node["policy"].as<std::string>() : "drop";
+            if (policy == "coalesce")
+            {
+                limit.policy = RateLimiter::Policy::Coalesce;
+            }
+            else if (policy != "drop")
+            {
+                CONSOLE_WARN(console, LogTag::Gui, "Unknown rate limit policy '%s' for topic '%s', drop used", policy.c_str(), topic.c_str());
+            }
+            robot_com->setRateLimit(topic, limit);
+            CONSOLE_INFO(console, LogTag::Gui, "Mqtt inbound %s limited to %.1f/s (burst %d) per sender, %.1f/s (burst %d) in total, %s",
+                         topic.c_str(), limit.rate, limit.burst, limit.topic_rate, limit.topic_burst, policy.c_str());
+        }
+    }
+    if (config["command_queue_size"])       command_queue.setCapacity(config["command_queue_size"].as<size_t>());
+    if (config["dedup_cache_size"])         command_dedup.setCapacity(config["dedup_cache_size"].as<size_t>());
+    if (config["dedup_window_ms"])          command_dedup.setWindow(config["dedup_window_ms"].as<int>());
+    CONSOLE_INFO(console, LogTag::Gui, "Mqtt brokers: %zu configured, primary %s, commands on '%s'",
+                 server.servers.size(), server.servers.empty()? "-" : server.servers.front().c_str(), server.command_topic.c_str());
+    CONSOLE_INFO(console, LogTag::Gui, "Mqtt keep-alive %d s, heartbeat every %d ms", options.keep_alive_s, options.heartbeat_interval_ms);
 }
 
-void gui_plugin::SHARP::executeMQTTCommand(QString command)
+void gui_plugin::SHARP::updateLinkStatus()
 {
-    // Abort all current missions
-    on_pushButton_Abort_clicked();
+    if (!robot_com->isReady())
+    {
+        ui->label_mqttLink->setText(QString("MQTT: %1").arg(MqttConnection::stateName(robot_com->connectionState())));
+        ui->label_mqttLink->setStyleSheet("color: rgb(255, 0, 0)");
+        return;
+    }
 
-    // Execute received command
-    std::string info = "MQTT Command Received: " + command.toStdString();
-    console->print(info);
+    Heartbeat::Stats stats = robot_com->heartbeatStats();
+    ui->label_mqttLink->setText(QString("MQTT: %6 | RTT last %1 ms, p50 %2 ms, p95 %3 ms, max %4 ms | missed %5")
+                                .arg(stats.last_ms, 0, 'f', 1).arg(stats.p50_ms, 0, 'f', 1)
+                                .arg(stats.p95_ms, 0, 'f', 1).arg(stats.max_ms, 0, 'f', 1).arg(stats.missed)
+                                .arg(QString::fromStdString(robot_com->currentServer())));
+
+    // Rolling histogram in the tooltip
+    QString histogram = QString("RTT histogram (last %1 pings)").arg(stats.samples);
+    int lower = 0;
+    for (int i = 0; i < Heartbeat::BUCKET_COUNT; i++)
+    {
+        int upper = Heartbeat::bucketLimit(i);
+        QString range = (upper < 0)? QString(">= %1 ms").arg(lower) : QString("%1-%2 ms").arg(lower).arg(upper);
+        histogram += QString("\n%1: %2").arg(range, -12).arg(stats.histogram[i]);
+        lower = upper;
+    }
+    DeliveryTracker::Stats delivery = robot_com->deliveryStats();
+    histogram += QString("\n\nPUBACK latency p50 %1 ms, p95 %2 ms, max %3 ms, in flight %4/%5 (max %6)")
+                 .arg(delivery.latency.p50_ms, 0, 'f', 1).arg(delivery.latency.p95_ms, 0, 'f', 1)
+                 .arg(delivery.latency.max_ms, 0, 'f', 1).arg(delivery.in_flight).arg(delivery.window).arg(delivery.max_in_flight);
+    histogram += QString("\nPublishes: %1 sent, %2 acked, %3 retried, %4 failed, %5 timed out, %6 held back")
+                 .arg(delivery.sent).arg(delivery.acked).arg(delivery.retried).arg(delivery.failed)
+                 .arg(delivery.timed_out).arg(delivery.deferred);
+    TopicRouter::Stats router = robot_com->routerStats();
+    histogram += QString("\nInbound: %1 routed, %2 unmatched, %3 not JSON, worker backlog %4 (max %5)")
+                 .arg(router.routed).arg(router.unmatched).arg(router.invalid_json)
+                 .arg(router.worker_backlog).arg(router.max_worker_backlog);
+    OutboundJournal::Stats journal = robot_com->journalStats();
+    histogram += QString("\nJournal: %1 pending, %2 replayed at startup, %3 syncs, %4 bytes")
+                 .arg(journal.pending).arg(journal.replayed).arg(journal.syncs).arg(journal.file_bytes);
+    histogram += QString("\nSession: %1 robots on client %2, %3 messages outside any robot namespace")
+                 .arg(robot_com->sessionRobotCount()).arg(QString::fromStdString(robot_com->clientId()))
+                 .arg(robot_com->sessionUnroutedCount());
+    RateLimiter::Stats limited = robot_com->rateLimitStats();
+    histogram += QString("\nRate limited: %1 dropped (%2 by topic cap), %3 coalesced, %4 released, %5 held, %6 priority, %7 senders tracked")
+                 .arg(limited.dropped).arg(limited.topic_limited).arg(limited.coalesced).arg(limited.released)
+                 .arg(limited.held).arg(limited.priority).arg(limited.buckets);
+    CommandQueue::Stats queue = command_queue.stats();
+    CommandDedup::Stats dedup = command_dedup.stats();
+    histogram += QString("\n\nCommands: %1 dispatched, %2 rejected, %3 discarded, %4 expired, max %5 waiting")
+                 .arg(queue.dispatched).arg(queue.rejected).arg(queue.discarded).arg(queue.expired).arg(queue.max_depth);
+    histogram += QString("\nDuplicates ignored: %1 (%2 by id, %3 by content)")
+                 .arg(dedup.hits).arg(dedup.id_hits).arg(dedup.hash_hits);
+    ui->label_mqttLink->setToolTip(histogram);
+
+    // Degraded link: pings lost or slow round trips
+    bool degraded = stats.consecutive_missed > 0 || stats.p95_ms >= LINK_DEGRADED_RTT_MS;
+    ui->label_mqttLink->setStyleSheet(degraded? "color: rgb(255, 140, 0)" : "");
+}
+
+void gui_plugin::SHARP::dispatchMQTTCommands()
+{
+    if (cmd_processor->isRunning())
+    {
+        // Abort the running mission once, the next command is dispatched when it has finished
+        if (command_queue.hasPreempt() && !preempting)
+        {
+            preempting = true;
+            on_pushButton_Abort_clicked();
+        }
+        return;
+    }
+    preempting = false;
+    if (!running_dedup_key.empty())
+    {
+        command_dedup.finish(running_dedup_key);
+        running_dedup_key.clear();
+    }
+
+    // Commands that outlived their message expiry while queued never reach the processor
+    InboundCommand command;
+    std::vector<InboundCommand> expired;
+    bool popped = command_queue.pop(command, expired);
+    for (const InboundCommand &stale : expired)
+    {
+        cmd_processor->rejectCommand(stale.name, "expired", stale.request);
+        command_dedup.forget(stale.dedup_key);
+    }
+    if (!popped)
+    {
+        return;
+    }
+
+    CommandQueue::Stats stats = command_queue.stats();
+    CONSOLE_INFO(console, LogTag::Gui, "MQTT Command Received: %s (%.1f ms in queue, %zu waiting)",
+                 command.name.c_str(), stats.last_latency_ms, stats.depth);
     if(!configured)
     {
-        console->print("ERROR: Configuration directory not set");
+        CONSOLE_ERROR(console, LogTag::Gui, "Configuration directory not set");
+        cmd_processor->rejectCommand(command.name, "configuration directory not set", command.request);
+        command_dedup.forget(command.dedup_key);
+        // Answer the remaining commands as well
+        dispatchMQTTCommands();
     }
     else
     {
-        cmd_processor->executeMission(command, config_dir);
+        running_dedup_key = command.dedup_key;
+        cmd_processor->executeMission(command.message, config_dir, command.request);
     }
 }
 
 void gui_plugin::SHARP::OnMissionSequenceCompleted(bool status)
 {
-    console->print("Mission Sequence Completed");
+    CONSOLE_INFO(console, LogTag::Gui, "Mission Sequence Completed");
     if (current_button != NULL)
     {
         QString style = (status)? "" : "background-color: rgb(255, 0, 0)";
@@ -310,9 +614,9 @@ void gui_plugin::SHARP::on_pushButton_Dock_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Robot Dock Request");
+    CONSOLE_INFO(console, LogTag::Gui, "Robot Dock Request");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "dock";
@@ -323,9 +627,9 @@ void gui_plugin::SHARP::on_pushButton_Undock_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Robot Undock Request");
+    CONSOLE_INFO(console, LogTag::Gui, "Robot Undock Request");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "undock";
@@ -336,13 +640,13 @@ void gui_plugin::SHARP::on_pushButton_deliverCommode_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "deliver";
     mission["bed_id"] = ui->lineEdit_deliveryBed->text().toInt();
-    console->print("Commode Deliver Request to bed: " + mission["bed_id"].asString());
+    CONSOLE_INFO(console, LogTag::Gui, "Commode Deliver Request to bed: %d", mission["bed_id"].asInt());
     cmd_processor->executeMission(QString::fromStdString(writer.write(mission)), config_dir);
 }
 
@@ -350,19 +654,19 @@ void gui_plugin::SHARP::on_pushButton_cleanCommode_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "collect";
     mission["bed_id"] = ui->lineEdit_collectionBed->text().toInt();
-    console->print("Commode Collect Request from bed: " + mission["bed_id"].asString());
+    CONSOLE_INFO(console, LogTag::Gui, "Commode Collect Request from bed: %d", mission["bed_id"].asInt());
     cmd_processor->executeMission(QString::fromStdString(writer.write(mission)), config_dir);
 }
 
 void gui_plugin::SHARP::on_pushButton_openDoor_clicked()
 {
-    console->print("Door Open Command");
+    CONSOLE_INFO(console, LogTag::Gui, "Door Open Command");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "door_open";
@@ -371,7 +675,7 @@ void gui_plugin::SHARP::on_pushButton_openDoor_clicked()
 
 void gui_plugin::SHARP::on_pushButton_closeDoor_clicked()
 {
-    console->print("Door Close Command");
+    CONSOLE_INFO(console, LogTag::Gui, "Door Close Command");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "door_close";
@@ -382,9 +686,9 @@ void gui_plugin::SHARP::on_pushButton_safetyOn_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Turning On Collision Safety");
+    CONSOLE_INFO(console, LogTag::Gui, "Turning On Collision Safety");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "safety_on";
@@ -395,9 +699,9 @@ void gui_plugin::SHARP::on_pushButton_safetyOff_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Turning Off Collision Safety");
+    CONSOLE_INFO(console, LogTag::Gui, "Turning Off Collision Safety");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "safety_off";
@@ -408,9 +712,9 @@ void gui_plugin::SHARP::on_pushButton_parkCommode_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Collecting Commode and Moving to Parking");
+    CONSOLE_INFO(console, LogTag::Gui, "Collecting Commode and Moving to Parking");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "park";
@@ -437,13 +741,18 @@ void gui_plugin::SHARP::on_pushButton_initDisabledState_clicked()
     cmd_processor->initRobotState(CommandProcessor::RobotState::Disabled);
 }
 
+void gui_plugin::SHARP::on_lineEdit_logFilter_textChanged(const QString &text)
+{
+    console->setFilter(text);
+}
+
 void gui_plugin::SHARP::on_pushButton_gripperExtend_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Extending");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Extending");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_extend";
@@ -454,9 +763,9 @@ void gui_plugin::SHARP::on_pushButton_grpperRetract_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Retracting");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Retracting");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_retract";
@@ -467,9 +776,9 @@ void gui_plugin::SHARP::on_pushButton_gripperClamp_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Clamping");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Clamping");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_clamp";
@@ -480,9 +789,9 @@ void gui_plugin::SHARP::on_pushButton_gripperRelease_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Releasing");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Releasing");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_release";
@@ -493,9 +802,9 @@ void gui_plugin::SHARP::on_pushButton_gripperExtendedClamp_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Extended Clamping");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Extended Clamping");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_extended_clamp";
@@ -506,9 +815,9 @@ void gui_plugin::SHARP::on_pushButton_gripperExtendedRelease_clicked()
 {
     if (!configured)
     {
-        console->print("Warning: Configuration Directory Not Set");
+        CONSOLE_WARN(console, LogTag::Gui, "Configuration Directory Not Set");
     }
-    console->print("Gripper Extended Releasing");
+    CONSOLE_INFO(console, LogTag::Gui, "Gripper Extended Releasing");
     Json::Value mission;
     Json::FastWriter writer;
     mission["command"] = "gripper_extended_release";
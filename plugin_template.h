@@ -11,6 +11,9 @@
 #include "Tools/console.h"
 #include "command_processor/commandprocessor.h"
 #include "Tools/robotCommunication.h"
+#include "Tools/mqttlogsink.h"
+#include "Tools/commanddedup.h"
+#include "Tools/commandqueue.h"
 
 #ifdef USING_COMMANDPUB2
 #include "../../common/mission/robot_status_data2.h"
@@ -20,6 +23,9 @@
 #include "../../common/mission/mission_data.h"
 #endif
 
+// Dynamic property holding the robot name, set by the plugin export before onSetRobotName
+#define PROPERTY_ROBOT_NAME "robot_name"
+
 namespace Ui {
 class SHARP;
 }
@@ -52,7 +58,7 @@ private slots:
 
     void on_pushButton_Abort_clicked();
 
-    void executeMQTTCommand(QString command);
+    void dispatchMQTTCommands(void);
 
     void on_pushButton_Dock_clicked();
 
@@ -92,8 +98,10 @@ private slots:
 
     void on_pushButton_initDisabledState_clicked();
 
+    void on_lineEdit_logFilter_textChanged(const QString &text);
+
 signals:
-    void mqtt_cb(QString msg);
+    void mqtt_cb(QString command);
 
 private:
     /// GUI for this widget
@@ -113,15 +121,32 @@ private:
     void OnMissionCompleted(const QJsonObject &jobj);
     void OnMissionSequenceCompleted(bool status);
     int sendMission(QByteArray mission_data);
-    void command_callback(std::string msg);
+    void command_callback(std::string msg, const RequestContext &request);
+    void configureLogging(const YAML::Node &config);
+    void configureMqtt(const YAML::Node &config);
+    void updateLinkStatus(void);
+
+    // Heartbeat p95 round trip above which the MQTT link is shown as degraded
+    const double LINK_DEGRADED_RTT_MS = 500;
 
     // Console Object
     Console *console;
 
     // Command Processor
     CommandProcessor *cmd_processor;
+    // Inbound MQTT commands waiting for the command processor
+    CommandQueue command_queue;
+    bool preempting = false;
+    // Recently accepted commands, QoS 1 redeliveries are acknowledged but not executed again
+    CommandDedup command_dedup;
+    // Key of the command given to the processor, finished once it has run
+    std::string running_dedup_key;
     // Communicator
     RobotCommunication *robot_com;
+    // Publishes warnings and errors for central monitoring
+    MqttLogSink *mqtt_log_sink;
+    // Binary event log of mission steps and MQTT traffic
+    FlightRecorder *flight_recorder;
 };
 
 } // gui_plugin